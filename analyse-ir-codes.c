@@ -11,6 +11,13 @@
 #include "import.h"
 #include "analyse.h"
 #include "export.h"
+#include "compress.h"
+#include "cache.h"
+#include "store.h"
+#include "stats.h"
+#include "verify.h"
+
+#include "stringHashes.h"
 
 #define DEBUG   1
 #define VERSION "0.1"
@@ -23,26 +30,87 @@ tGlobals globals = {
 };
 
 
-tIRCodeSet  *gIRCodeSets = NULL;	/* linked list of IR code sets */
-tIRCode     *gIRCodes    = NULL;        /* master list of all IR codes */
+tCodeStore  gStore       = CODE_STORE_INITIALIZER;
+tArena      gArena       = ARENA_INITIALIZER;
 
 static const char *usageString = 
 {
-"    -i <file>    input file (defaults to stdin, if not a tty)\n"
-"    -o <file>    output file (defaults to stdout)\n"
+"    -i <file>    input file (defaults to stdin, if not a tty) - may be gzip compressed\n"
+"    -o <file>    output file (defaults to stdout) - gzip compressed if it ends in '.gz'\n"
+"    -z           gzip compress the output\n"
 "    -l <file>    input file (defaults to stderr)\n"
+"    -m           map the input file into memory, rather than reading it a line at a time\n"
+"    -j <count>   number of threads to import, analyse and compress with (implies -m)\n"
+"    -s           stream - analyse and output each code set as soon as it has been read\n"
+"    -F <format>  input format, 'text' (the default) or 'binary'\n"
+"    -f <format>  output format, 'text' (the default), 'binary' or 'firmware'\n"
+"    -c           convert only - don't analyse or adjust the codes\n"
+"    -C <file>    fingerprint cache - codes found in it aren't analysed again\n"
 "    -d <level>   debug level (0+)\n"
 "    -q           'quiet' - suppress everything except fatal and error messages.\n"
+"    -L           drop log messages, rather than wait, if the log can't keep up\n"
+"    -S <file>    write timings and counts for each phase to <file> as JSON ('-' for stdout)\n"
+"    --stats <file> same as -S\n"
+"    --verify     also analyse every code the original, unoptimized way, and report any differences\n"
 };
 
 
+tDBFormat formatFromName(const char *name)
+{
+    const char    *s = name;
+    unsigned long hash = 0;
+
+    while (*s != '\0')
+        hash = STRING_HASH_STEP(hash, *s++);
+
+    switch (hash)
+    {
+    case qHashtext:     return kTextFormat;
+    case qHashbinary:   return kBinaryFormat;
+    case qHashfirmware: return kFirmwareFormat;
+    default:
+        fatalExit(-2, "don't understand format \'%s\'", name);
+    }
+}
+
+/* streaming - called by the importer as each code set is completed */
+void streamIRCodeSet(tIRCodeSet *codeSet, void *outputFile)
+{
+    /* the import phase is whatever time isn't spent in here */
+    endPhase(kImportPhase);
+    countCodeSet(codeSet);
+
+    startPhase(kAnalysisPhase);
+    analyzeIRCodeSet(codeSet);
+    endPhase(kAnalysisPhase);
+
+    startPhase(kExportPhase);
+    exportIRCodeSet((FILE *)outputFile, codeSet);
+    endPhase(kExportPhase);
+
+    startPhase(kImportPhase);
+}
+
 int main(int argc, const char *argv[])
 {
     int     i;
     int     debugLevel;
+    int     mapInput;
+    int     threadCount;
+    int     streaming;
+    int     convertOnly;
+    int     compressOutput;
+    int     verify;
+    unsigned long differences;
+    int     result, error, cacheError;
+    size_t  length;
+    tDBFormat inputFormat, outputFormat;
+    const char *cacheName;
+    const char *statsName;
     char    *p;
     time_t  now;
     FILE    *inputFile, *outputFile, *logFile;
+    FILE    *importFile, *exportFile;
 
     enum {
         kInputFile  = 'i',
@@ -50,6 +118,16 @@ int main(int argc, const char *argv[])
         kLogFile    = 'l',
         kDebugLevel = 'd',
         kQuiet      = 'q',
+        kDropLog    = 'L',
+        kMapInput   = 'm',
+        kThreads    = 'j',
+        kStreaming  = 's',
+        kInputFormat  = 'F',
+        kOutputFormat = 'f',
+        kConvertOnly  = 'c',
+        kCompress   = 'z',
+        kCache      = 'C',
+        kStats      = 'S',
         kNormal     = 'n'
     } optState;
 
@@ -57,6 +135,19 @@ int main(int argc, const char *argv[])
 
     inputFile = stdin;
     outputFile = stdout;
+    mapInput = 0;
+    threadCount = 1;
+    streaming = 0;
+    convertOnly = 0;
+    compressOutput = 0;
+    verify = 0;
+    differences = 0;
+    error = 0;
+    cacheError = 0;
+    cacheName = NULL;
+    statsName = NULL;
+    inputFormat = kTextFormat;
+    outputFormat = kTextFormat;
 
     globals.myName = argv[0];
     p = strrchr( globals.myName, '/' );
@@ -82,7 +173,21 @@ int main(int argc, const char *argv[])
     for (i = 1; i < argc; ++i)
     {
         logDebug(0,"argv[%d] = \'%s\'\n", i, argv[i]);
-        if (argv[i][0] == '-')
+        if (strcmp(argv[i], "--stats") == 0)
+        {
+            if (optState == kNormal)
+                optState = kStats;
+            else
+                fatalExit(-5, "bad combination of options");
+        }
+        else if (strcmp(argv[i], "--verify") == 0)
+        {
+            if (optState == kNormal)
+                verify = 1;
+            else
+                fatalExit(-5, "bad combination of options");
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
         {
             const char *p = &argv[i][1];
             while (*p != '\0')
@@ -114,6 +219,57 @@ int main(int argc, const char *argv[])
                     setLogThreshold( LOG_ERR );
                     break;
 
+                case kDropLog:
+                    setLogOverflow( kLogDrop );
+                    break;
+
+                case kMapInput:
+                    mapInput = 1;
+                    break;
+
+                case kStreaming:
+                    streaming = 1;
+                    break;
+
+                case kConvertOnly:
+                    convertOnly = 1;
+                    break;
+
+                case kCompress:
+                    compressOutput = 1;
+                    break;
+
+                case kInputFormat:
+                case kOutputFormat:
+                case kCache:
+                case kStats:
+                    if (optState == kNormal)
+                        optState = *p;
+                    else
+                        fatalExit(-5, "bad combination of options");
+                    break;
+
+                case kThreads:
+                    ++p;
+                    if (!isdigit(*p))
+                    {
+                        if (optState == kNormal)
+                            optState = kThreads;
+                        else
+                            fatalExit(-5, "bad combination of options");
+                    }
+                    else
+                    {
+                        threadCount = 0;
+                        do {
+                            /* accumulate digits */
+                            threadCount = (threadCount * 10) + (*p++ - '0');
+                        } while (isdigit(*p));
+                    }
+                    mapInput = 1;
+                    --p; /* pre-compensate for ++p after switch */
+                    break;
+
                 case kInputFile:
                     if (optState == kNormal)
                         optState = kInputFile;
@@ -154,6 +310,34 @@ int main(int argc, const char *argv[])
                 optState = kNormal;
                 break;
 
+            case kThreads:
+                threadCount = atoi(argv[i]);
+                optState = kNormal;
+                break;
+
+            case kInputFormat:
+                inputFormat = formatFromName( argv[i] );
+                if (inputFormat == kFirmwareFormat)
+                    fatalExit(-2, "firmware blobs can't be read back in");
+                optState = kNormal;
+                break;
+
+            case kOutputFormat:
+                outputFormat = formatFromName( argv[i] );
+                optState = kNormal;
+                break;
+
+            case kCache:
+                cacheName = argv[i];
+                optState = kNormal;
+                break;
+
+            case kStats:
+                statsName = argv[i];
+                enableStats();
+                optState = kNormal;
+                break;
+
             case kInputFile:
                 inputFile = fopen( argv[i], "r" );
                 if (inputFile == NULL)
@@ -171,6 +355,9 @@ int main(int argc, const char *argv[])
                     outputFile = stdout;
                     fatalExitErrno( -3, "unable to open output file \"%s\"", argv[i] );
                 }
+                length = strlen( argv[i] );
+                if ( length > 3 && strcmp( &argv[i][length - 3], ".gz" ) == 0 )
+                    compressOutput = 1;
                 optState = kNormal;
                 break;
 
@@ -205,17 +392,107 @@ int main(int argc, const char *argv[])
         fatalExit(-1, "Usage: not enough arguments provided.\n\n%s", usageString);
     }
 
-    importDB(inputFile);
+    /* either may hand back a pipe to a thread doing the (de)compression */
+    importFile = openDecompressor(inputFile);
+    exportFile = compressOutput ? openCompressor(outputFile, threadCount) : outputFile;
+
+    if (verify && (streaming || convertOnly))
+        fatalExit(-5, "--verify cannot be combined with -s or -c");
+
+    /* the run goes on without a cache that can't be read, but still fails at the end */
+    if (cacheName != NULL && !convertOnly)
+        cacheError = loadFingerprintCache(cacheName);
+
+    if (streaming)
+    {
+        if (mapInput || convertOnly || inputFormat != kTextFormat || outputFormat != kTextFormat)
+            fatalExit(-5, "-s cannot be combined with -m, -j, -c, -F or -f");
+
+        startPhase(kImportPhase);
+        error = importStreamDB(importFile, streamIRCodeSet, exportFile);
+        endPhase(kImportPhase);
+
+        dumpFingerprintStats();
+    }
+    else
+    {
+        startPhase(kImportPhase);
+        if (mapInput && inputFormat == kTextFormat)
+            error = importMappedDB(importFile, threadCount);
+        else
+            error = importDB(importFile, inputFormat);
+        endPhase(kImportPhase);
+
+        for (i = 0; statsEnabled() && (size_t)i < gStore.codeSetCount; ++i)
+            countCodeSet(&gStore.codeSets[i]);
+
+        /* a failed import may have left only part of the database - don't pass it on */
+        if (error == 0 && !convertOnly)
+        {
+            /* before the streams are adjusted - it isn't counted as part of any phase */
+            if (verify)
+                startVerify(threadCount);
+
+            startPhase(kAnalysisPhase);
+            analyzeIRCodeSets(threadCount);
+            endPhase(kAnalysisPhase);
 
-    analyzeIRCodeSets();
+            if (verify)
+                differences = finishVerify();
+        }
 
-    exportDB(outputFile);
+        if (error == 0)
+        {
+            startPhase(kExportPhase);
+            error = exportDB(exportFile, outputFormat, threadCount);
+            endPhase(kExportPhase);
+        }
+    }
+
+    if (cacheName != NULL && !convertOnly)
+    {
+        result = saveFingerprintCache(cacheName);
+        if (error == 0)
+            error = cacheError;
+        if (error == 0)
+            error = result;
+    }
+
+    /* a truncated or corrupt .gz input only shows up here */
+    result = closeDecompressor(importFile);
+    if (error == 0)
+        error = result;
+
+    /* waits for the compressor to catch up, so it's part of the export */
+    startPhase(kExportPhase);
+    result = closeCompressor(exportFile);
+    if (error == 0)
+        error = result;
+    endPhase(kExportPhase);
 
     if (inputFile != stdin)
         fclose(inputFile);
 
-    if (outputFile != stdout)
-        fclose(outputFile);
+    if (fflush(outputFile) != 0 || (outputFile != stdout && fclose(outputFile) != 0))
+    {
+        logErrorErrno("error writing the output file");
+        if (error == 0)
+            error = -3;
+    }
+
+    if (statsName != NULL)
+    {
+        result = writeStats(statsName, threadCount);
+        if (error == 0)
+            error = result;
+    }
+
+    releaseCodeStore(&gStore);
+    arenaRelease(&gArena);
+
+    /* -3 for I/O errors, -4 if memory ran out - either trumps a verify difference */
+    if (error == 0 && differences != 0)
+        error = -6;
 
-    exit(0);
+    exit(error);
 }
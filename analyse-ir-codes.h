@@ -4,8 +4,40 @@
     Copyright 2011, Paul Chambers. All Rights Reserved.
 */
 
+#include "arena.h"
+
 #define STRING_HASH_STEP(hash, ch) ((hash * 33) ^ (ch))
 
+/* 64 bit FNV-1a, a word at a time - for hashing IR streams */
+#define WORD_HASH_SEED  0xCBF29CE484222325ULL
+#define WORD_HASH_STEP(hash, word) (((hash) ^ (unsigned long long)(word)) * 0x100000001B3ULL)
+
+/* seeded hashes used by the perfect hash tables built by generateMappings */
+static inline unsigned int finalizeHash(unsigned int h)
+{
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline unsigned int hashId(unsigned long id, unsigned int seed)
+{
+    return finalizeHash( (unsigned int)id ^ (seed * 0x9E3779B9U) );
+}
+
+static inline unsigned int hashName(const char *name, size_t length, unsigned int seed)
+{
+    unsigned int h = 2166136261U ^ (seed * 0x9E3779B9U);
+
+    while (length-- > 0)
+        h = (h ^ (unsigned char)*name++) * 16777619U;
+
+    return finalizeHash(h);
+}
+
 typedef struct {
     const char *    myName;
     const char *    version;
@@ -38,6 +70,12 @@ typedef enum {
 /* indexed by tBrand */
 extern const char *gBrandName[];
 
+typedef enum {
+    kTextFormat,
+    kBinaryFormat,
+    kFirmwareFormat     /* output only */
+} tDBFormat;
+
 typedef enum {
     kUnknownRepeat,
     kFullRepeat,
@@ -173,20 +211,22 @@ typedef struct
 } tFingerprint;
 
 
-typedef struct tIRCode
+/* kept apart from the rest of the code - only output and diagnostics need it */
+typedef struct
 {
-    struct tIRCode *next, *nextA;
-    struct tIRCodeSet *parent;
+    unsigned int    lineNumber;     /* in the input file. Useful for error reporting */
 
-    unsigned int    lineNumber; /* in the input file. Useful for error reporting */
+    const char      *label;         /* NOT NUL-terminated - may point into the mapped input file */
+    unsigned int    labelLength;
+
+} tIRCodeLabel;
+
+typedef struct tIRCode
+{
+    unsigned int    codeSet;    /* index into the store's codeSets */
 
     tFingerprint    fingerprint;
     
-    struct {
-        char *label;
-        /* int action; */
-    } button;
-
     struct {
     tIRStream  *a;
     tIRStream  *b;
@@ -196,15 +236,45 @@ typedef struct tIRCode
 
 typedef struct tIRCodeSet
 {
-    struct tIRCodeSet *next;
-
     unsigned int    id;
     tDeviceType     deviceType;
     tBrand          brand;
 
-    tIRCode *irCodes, *lastIrCode;
+    size_t          firstCode, codeCount;   /* the range of the store's codes that belong to it */
 
 } tIRCodeSet;
 
-extern tIRCodeSet   *gIRCodeSets;
-extern tIRCode      *gIRCodes;
+/*
+    The database, as arrays rather than linked lists - code sets in input
+    order, and the codes grouped by code set. labels[] runs parallel to
+    codes[]. A pass over the codes walks straight through memory.
+*/
+typedef struct
+{
+    tIRCodeSet      *codeSets;
+    size_t          codeSetCount, codeSetSize;
+
+    tIRCode         *codes;
+    tIRCodeLabel    *labels;
+    size_t          codeCount, codeSize;
+
+    tArena          labelText;  /* labels copied from the input, so they don't sit among the streams */
+
+} tCodeStore;
+
+#define CODE_STORE_INITIALIZER  { NULL, 0, 0, NULL, NULL, 0, 0, ARENA_INITIALIZER }
+
+extern tCodeStore   gStore;
+
+static inline tIRCodeSet *codeSetOf(const tIRCode *code)
+{
+    return &gStore.codeSets[code->codeSet];
+}
+
+static inline tIRCodeLabel *labelOf(const tIRCode *code)
+{
+    return &gStore.labels[code - gStore.codes];
+}
+
+/* owns the streams and histograms */
+extern tArena       gArena;
@@ -8,9 +8,16 @@
 
 #include "common.h"
 
+#include <pthread.h>
+
 #include "analyse-ir-codes.h"
 #include "analyse.h"
+#include "cache.h"
+#include "match.h"
+#include "stats.h"
 
+/* bump this when a change to the analysis alters the fingerprints it produces */
+#define FINGERPRINT_VERSION 1
 
 /* indexed by tDeviceType */
 const char *gDeviceTypeName[] = 
@@ -45,44 +52,9 @@ struct {
 
 tReferenceFingerprint gProtocol[] = 
 {
-    /* encoding, symbolCounts, carrierFreq, leading {mark, space}, durations, mark symbols, space symbols */
-
-    { kFromSpec,  "NEC",             kSpaceVaries,       {32},           38000, {342,171}, 4104, {21},     {21,64}, kNECRepeatStream },
-    { kFromSpec,  "Sony SIRCS",      kMarkVaries,        {12,15,20},     40000, {96},      1800, {24,48},  {24}     },
-    { kFromSpec,  "Philips RC-5",    kBiphase,           {13},           36000, {0},       4445, {32,64},  {32,64}  },
-    { kFromSpec,  "Philips RC-5 (a)", kAmbiguous,        {12},           36000, {0},       4445, {32,64},  {32,64}  }, /* RC-5 '0' digit */
-    { kFromSpec,  "Philips RC-5e",   kBiphaseExtended,   {18,19},        36000, {0},       4445, {32,64},  {32,64}  },
-    { kFromSpec,  "JVC (1)",         kSpaceVaries,       {16,32},        38000, {320,160}, 2195, {20},     {20,60}  },
-    { kFromSpec,  "JVC (2)",         kSpaceVaries,       {16,32},        38000, {320,160}, 3373, {20},     {20,60}  },
-    /* the following were measured */
-    { kMeasured,  "Panasonic",       kSpaceVaries,       {48},           37000, {128,64},  4673, {16},     {16,48}  },
-    { kMeasured,  "RCA",             kSpaceVaries,       {24},           57360, {229,229}, 3695, {29},     {57,114} },
-    { kMeasured,  "Denon",           kSpaceVaries,       {15},           38000, {0},       2564, {10},     {30,70}  },
-    /* the following I created by hand, from analysis of the database */
-    { kFromDB,    "NEC-like (1)",    kSpaceVaries,       {32},           38000, {171,171}, 4104, {21},     {21,64}  },
-    { kFromDB,    "NEC-Like (2)",    kSpaceVaries,       {32},           38000, {342,171}, 5893, {21},     {21,64}  },
-    { kFromDB,    "NEC-Like (3)",    kSpaceVaries,       {28,40,42},     38000, {342,171}, 4104, {21},     {21,64}  },
-    { kFromDB,    "Mitsubishi?",     kSpaceVaries,       {16},           33000, {0},       1822, {11},     {28,67}  },
-    { kFromDB,    "Mystery2?",       kSpaceVaries,       {10},           36000, {0},        872, {11},     {26,64}  },
-    { kFromDB,    "JVC?",            kSpaceVaries,       {16},           58800, {0,360},   3600, {26},     {97,163} },
-    { kFromDB,    "Philips? (1)",    kBiphaseExtended,   {37},           37000, {98},      3886, {17,33,50}, {15,31} },
-    { kFromDB,    "Philips? (2)",    kBiphase,           {22,23},        38000, {102},     4000, {18,34},  {16,32}  },
-    { kFromDB,    "Philips? (3)",    kBiphaseExtended,   {19,20},        38000, {102},     4000, {18,34},  {16,32}  },
-    { kFromDB,    "TCL (Philips?)",  kBiphase,           {13},           38400, {0},       4062, {16,32},  {16,32}  },
-    { kFromDB,    "Fujitsu?",        kSpaceVaries,       {48},           38400, {132,59},  3904, {20},     {11,44}  }, /* set 100061,200033 */
-    { kFromDB,    "Panasonic? (3)",  kSpaceVaries,       {48},           37000, {128,64},  3200, {16},     {16,48}  },
-    { kFromDB,    "Panasonic? (4)",  kSpaceVaries,       {22},           56000, {196,196}, 5668, {50},     {45,140} },
-    { kFromDB,    "Funai?",          kSpaceVaries,       {24},           38400, {136,136}, 4065, {35},     {31,100} },
-    { kFromDB,    "Mystery1?",       kPPM,               {16,21,22},     40000, {0},       7138, {21},     {18,163,203} },
-    { kFromDB,    "Pace?",           kSpaceVaries,       {17},           40000, {361},     4000, {23},     {86,178} },     /* set 200011, 200003 */
-    { kFromDB,    "Samsung? (2)",    kPPM,               {38},           38400, {172},     4608, {10},     {20,657} },
-    { kFromDB,    "Samsung? (1)",    kSpaceVaries,       {48},           38400, {96,71},   3724, {17},     {15,43}  },
-    { kFromDB,    "Yamaha?",         kPPM,               {18},           38400, {323},     2550, {23},     {17,53,157} },  /* set 100090,100060,100014 - two part? */
-    { kFromDB,    "Mystery3?",       kSpaceVaries,       {11},           48000, {0},       6000, {11},     {239,365} },
-    { kFromDB,    "Mystery4?",       kSpaceVaries,       {17},           38400, {94},      4400, {47},     {44,106} },     /* set 200024 */
-    { kFromDB,    "Zenith?",         kPPM,               {15},           40000, {0},       7110, {21},     {18,161,201} }, /* set 200008 */
-    { kFromDB,    "Mystery5?",       kBiphase,           {11,12,13,14},  38400, {230},     1950, {23,46},  {22,45}  },     /* set 200006 */
-    { kFromDB,    "Daewoo?",         kPPM,               {18},           38400, {308},     2291, {20},     {18,56,152} },  /* set 100093 - two part? */
+#define defineProtocol(...)  { __VA_ARGS__ },
+#include "protocolmapping.h"
+#undef defineProtocol
 
     { kListEnd }
 };
@@ -97,7 +69,11 @@ inline float periodToFloat( tPeriod x) { return (x/8.0); }
 */
 int fuzzyMatch(unsigned long reference, unsigned long value, unsigned int threshold)
 {
-    return ( ((abs(reference - value) * 1000 * 2) / (reference + value)) <  threshold );
+    unsigned long difference;
+
+    /* i.e. (difference * 2000) / (reference + value) < threshold, without the division */
+    difference = (reference > value) ? (reference - value) : (value - reference);
+    return ( difference * 1000 * 2 < threshold * (reference + value) );
 }
 
 int durationsMatch(int durationA, int durationB)
@@ -105,7 +81,7 @@ int durationsMatch(int durationA, int durationB)
     if ( (durationA * durationB) == 0 )
         return ((durationA + durationB) == 0);
 
-    return fuzzyMatch( durationA, durationB, 100 );
+    return fuzzyMatch( durationA, durationB, MATCH_TOLERANCE );
 }
 
 int checkSymbolCount(tReferenceFingerprint *reference, int symbolCount)
@@ -131,45 +107,192 @@ inline int checkEncoding( tEncoding referenceEncoding, tEncoding fingerprintEnco
     );
 }
     
+int protocolCount(void)
+{
+    int count;
+
+    for (count = 0; gProtocol[count].confidence != kListEnd; ++count)
+        { }
+
+    return count;
+}
+
+#define ENCODING_COUNT  (kBiphaseExtended + 1)
+
+/*
+    gProtocol[] preprocessed for identifyProtocol() and adjustIRStream().
+    The reference periods are scaled by carrier and turned into tolerance
+    bands once, rather than on every comparison. For each
+    fingerprint encoding and symbol count, 'candidate' lists the protocols
+    that checkEncoding() and checkSymbolCount() would accept, in table
+    order - so the first of them whose durations also match is the one a
+    scan of the whole table would have found.
+*/
+static struct {
+    int     built;
+    int     maxSymbols;     /* the highest symbol count of any protocol */
+    struct {
+        tFuzzyBand  leadMark, leadSpace, duration;      /* scaled by carrier */
+        tFuzzyBand  mark[REFERENCE_BANDS], space[REFERENCE_BANDS];
+    }       *band;          /* per gProtocol[] entry */
+    int     *first;         /* [encoding][symbol count] - into candidate[], plus one at the end */
+    int     *candidate;     /* indices into gProtocol[] */
+} gProtocolIndex;
+
+/* not thread-safe - called before any analysis threads are started */
+void buildProtocolIndex(void)
+{
+    tReferenceFingerprint   *protocol;
+    int count, refCarrier, slots, slot, encoding, symbols, i, j, n;
+
+    if (gProtocolIndex.built)
+        return;
+
+    initMatcher();
+    count = protocolCount();
+
+    gProtocolIndex.maxSymbols = 0;
+    for (i = 0; i < count; ++i)
+    {
+        for (j = 0; j < SYMBOL_ARRAY_SIZE; ++j)
+        {
+            if (gProtocol[i].symbolCounts[j] > gProtocolIndex.maxSymbols)
+                gProtocolIndex.maxSymbols = gProtocol[i].symbolCounts[j];
+        }
+    }
+
+    slots = ENCODING_COUNT * (gProtocolIndex.maxSymbols + 1);
+    gProtocolIndex.band  = calloc( count + 1, sizeof(*gProtocolIndex.band) );
+    gProtocolIndex.first = calloc( slots + 1, sizeof(int) );
+    if (gProtocolIndex.band == NULL || gProtocolIndex.first == NULL)
+        fatalExit(-4, "unable to allocate the protocol index");
+
+    for (i = 0; i < count; ++i)
+    {
+        protocol = &gProtocol[i];
+        refCarrier = protocol->carrierFreq/100;
+        gProtocolIndex.band[i].leadMark  = fuzzyBand( (int)((protocol->leading.mark*1000)/refCarrier), MATCH_TOLERANCE );
+        gProtocolIndex.band[i].leadSpace = fuzzyBand( (int)((protocol->leading.space*1000)/refCarrier), MATCH_TOLERANCE );
+        gProtocolIndex.band[i].duration  = fuzzyBand( (int)((protocol->duration*1000)/refCarrier), MATCH_TOLERANCE );
+
+        referenceBands( protocol->mark,  ADJUST_TOLERANCE, gProtocolIndex.band[i].mark );
+        referenceBands( protocol->space, ADJUST_TOLERANCE, gProtocolIndex.band[i].space );
+    }
+
+    /* count the candidates in each slot, then fill them in */
+    for (n = 0; n < 2; ++n)
+    {
+        j = 0;
+        for (encoding = 0; encoding < ENCODING_COUNT; ++encoding)
+        {
+            for (symbols = 0; symbols <= gProtocolIndex.maxSymbols; ++symbols)
+            {
+                slot = encoding * (gProtocolIndex.maxSymbols + 1) + symbols;
+                gProtocolIndex.first[slot] = j;
+
+                for (i = 0; i < count; ++i)
+                {
+                    if ( checkEncoding( gProtocol[i].encoding, encoding )
+                      && checkSymbolCount( &gProtocol[i], symbols ) )
+                    {
+                        if (n == 1)
+                            gProtocolIndex.candidate[j] = i;
+                        ++j;
+                    }
+                }
+            }
+        }
+        gProtocolIndex.first[slots] = j;
+
+        if (n == 0)
+        {
+            gProtocolIndex.candidate = calloc( j + 1, sizeof(int) );
+            if (gProtocolIndex.candidate == NULL)
+                fatalExit(-4, "unable to allocate the protocol index");
+        }
+    }
+
+    logDebug(1, "protocol index: %d protocols, %d candidates in %d slots", count, j, slots);
+    gProtocolIndex.built = 1;
+}
+
 tReferenceFingerprint *identifyProtocol(tFingerprint *fingerprint)
 {
-    tReferenceFingerprint   *result;
-    int refCarrier;
     int fpCarrier, fpLeadMark, fpLeadSpace, fpDuration;
+    int slot, i, p;
     
     /* scale appropriately, to avoid both overflow and loss-of-precision */
     fpCarrier = fingerprint->carrierFreq/100;
     fpLeadMark  = (fingerprint->leading.mark * 1000) / fpCarrier;
     fpLeadSpace = (fingerprint->leading.space * 1000) / fpCarrier;
     fpDuration  = (fingerprint->duration * 1000) / fpCarrier;
-    
-    result = &gProtocol[0];
-    while (result->confidence != kListEnd)
+
+    if ( (unsigned int)fingerprint->encoding >= ENCODING_COUNT
+      || fingerprint->symbolCount > (unsigned int)gProtocolIndex.maxSymbols )
+        return NULL;
+
+    slot = fingerprint->encoding * (gProtocolIndex.maxSymbols + 1) + fingerprint->symbolCount;
+    for (i = gProtocolIndex.first[slot]; i < gProtocolIndex.first[slot + 1]; ++i)
     {
-        refCarrier = result->carrierFreq/100;
+        p = gProtocolIndex.candidate[i];
         /* compare fingerprint with reference, see if they match */
-        if ( checkEncoding( result->encoding, fingerprint->encoding )
-          && checkSymbolCount(result, fingerprint->symbolCount)
-          && durationsMatch((result->leading.mark*1000)/refCarrier,  fpLeadMark )
-          && durationsMatch((result->leading.space*1000)/refCarrier, fpLeadSpace )
-          && durationsMatch((result->duration*1000)/refCarrier, fpDuration)
-        )
+        if ( inFuzzyBand( &gProtocolIndex.band[p].leadMark,  fpLeadMark )
+          && inFuzzyBand( &gProtocolIndex.band[p].leadSpace, fpLeadSpace )
+          && inFuzzyBand( &gProtocolIndex.band[p].duration,  fpDuration ) )
         {   /* we have a match */
-            ++result->matched;
-            return result;
+            return &gProtocol[p];
         }
-        ++result;
     }
 
-    ++result->matched;
     return NULL;
 }
 
+/*
+    A hash of everything besides the stream itself that decides the outcome
+    of analyzeIRStream() and identifyProtocol(). The fingerprint cache is
+    discarded when it changes.
+*/
+uint64_t fingerprintSignature(void)
+{
+    tReferenceFingerprint   *protocol;
+    uint64_t    hash = WORD_HASH_SEED;
+    const char  *s;
+    int         i;
+
+    hash = WORD_HASH_STEP( hash, FINGERPRINT_VERSION );
+    hash = WORD_HASH_STEP( hash, MATCH_TOLERANCE );
+    hash = WORD_HASH_STEP( hash, MAX_HIST_SIZE );
+
+    for (protocol = &gProtocol[0]; protocol->confidence != kListEnd; ++protocol)
+    {
+        hash = WORD_HASH_STEP( hash, protocol->confidence );
+        for (s = protocol->name; *s != '\0'; ++s)
+            hash = WORD_HASH_STEP( hash, *s );
+        hash = WORD_HASH_STEP( hash, protocol->encoding );
+        for (i = 0; i < SYMBOL_ARRAY_SIZE; ++i)
+            hash = WORD_HASH_STEP( hash, protocol->symbolCounts[i] );
+        hash = WORD_HASH_STEP( hash, protocol->carrierFreq );
+        hash = WORD_HASH_STEP( hash, protocol->leading.mark );
+        hash = WORD_HASH_STEP( hash, protocol->leading.space );
+        hash = WORD_HASH_STEP( hash, protocol->duration );
+        for (i = 0; i < 4; ++i)
+        {
+            hash = WORD_HASH_STEP( hash, protocol->mark[i] );
+            hash = WORD_HASH_STEP( hash, protocol->space[i] );
+        }
+        hash = WORD_HASH_STEP( hash, protocol->repeatStream );
+    }
+    return hash;
+}
+
 void dumpFingerprintStats(void)
 {
     tReferenceFingerprint   *protocol;
     int total = 0;
-    
+
+    if ( !logCompiledIn(LOG_DEBUG) )
+        return;
+
     logDebug(0, "--- table of fingerprints identified ---" );
 
     protocol = &gProtocol[0];
@@ -180,10 +303,13 @@ void dumpFingerprintStats(void)
     } 
     total += protocol->matched;
     logprintf(DEBUG_LINE_PREFIX "    %4d codes not identified out of %d (%d%%)\n",
-                protocol->matched, total, (protocol->matched * 100 / total) );
+                protocol->matched, total, (total > 0) ? (protocol->matched * 100 / total) : 0 );
 }
 
 
+/* the dumps are debug output - when that's compiled out, so are they */
+#if logCompiledIn(LOG_DEBUG)
+
 void dumpHistogram(tHistogram *hist)
 {
     tCount i;
@@ -302,7 +428,18 @@ void dumpIRCode(tIRCode *code)
     dumpIRStreams( code );
 }
 
-tHistogram *dupHistogram(tRawHistogram *raw)
+#else
+
+#define dumpHistogram(hist)
+#define dumpRepeatType(code)
+#define dumpFingerprint(fingerprint)
+#define dumpStream(stream)
+#define dumpIRStreams(code)
+#define dumpIRCode(code)
+
+#endif
+
+tHistogram *dupHistogram(tArena *arena, tRawHistogram *raw)
 {
     tHistogram *result;
     tCount i;
@@ -310,7 +447,7 @@ tHistogram *dupHistogram(tRawHistogram *raw)
     if (raw == NULL || raw->count == 0)
         return NULL;
     
-    result = calloc( 1, sizeof(tHistogram) + (raw->count * sizeof(tHistEntry)) );
+    result = arenaAlloc( arena, sizeof(tHistogram) + (raw->count * sizeof(tHistEntry)) );
     if (result != NULL)
     {
         result->count = raw->count;
@@ -323,7 +460,7 @@ tHistogram *dupHistogram(tRawHistogram *raw)
     return result;
 }
 
-tHistogram *normalizeRawHistogram(tRawHistogram *hist)
+tHistogram *normalizeRawHistogram(tArena *arena, tRawHistogram *hist)
 {
     tCount i;
     int refPeriod;
@@ -339,7 +476,7 @@ tHistogram *normalizeRawHistogram(tRawHistogram *hist)
         refPeriod = hist->d[i].period;
         periodSum = 0;
         periodCount = 0;
-        while ( (i < hist->count) && fuzzyMatch( refPeriod + 7, hist->d[i].period, 100) )
+        while ( (i < hist->count) && fuzzyMatch( refPeriod + 7, hist->d[i].period, MATCH_TOLERANCE) )
         {
             /* logprintf("[%d]=%d:%d,", i, hist->d[i].period, hist->d[i].count); */
 
@@ -364,45 +501,93 @@ tHistogram *normalizeRawHistogram(tRawHistogram *hist)
             periodSum, periodCount,
             (float)periodSum/(float)periodCount ); */
     }
-    return dupHistogram(&symbols);
+    return dupHistogram(arena, &symbols);
 }
 
-void insertIntoSortedHistogram( tRawHistogram *hist, tPeriod period )
+/* below this, an insertion sort beats clearing the radix sort's buckets */
+#define RADIX_SORT_MIN  32
+
+/*
+    Sorts periods into ascending order - a byte at a time, least significant
+    first, skipping the bytes that are the same in every period. 'scratch'
+    must have room for 'count' periods.
+*/
+void sortPeriods(tPeriod *period, tPeriod *scratch, size_t count)
 {
-    unsigned int insert,insertAt;
-    tCount j;
+    size_t  bucket[256], i, j, sum, n;
+    tPeriod *from, *to, *swap, differ, p;
+    unsigned int shift;
 
-    /* default is to append, if the loop completes (i.e. period is the largest seen so far) */
-    insert = 1;
-    insertAt = hist->count;
-    for (j = 0; j < hist->count; j++)
+    if (count < RADIX_SORT_MIN)
     {
-        if (period == hist->d[j].period)
+        for (i = 1; i < count; ++i)
         {
-            ++hist->d[j].count;
-            insert = 0;     /* don't insert, we found an existing entry */
-            break;          /* terminate loop, we're done */
+            p = period[i];
+            for (j = i; j > 0 && period[j-1] > p; --j)
+                period[j] = period[j-1];
+            period[j] = p;
         }
-        else if (period < hist->d[j].period)
-        { 
-            /* tell the insertion code where to insert */
-            insert = 1;
-            insertAt = j;
-            /* move the latter half of the array up by one, to make a hole */
-            for (j = hist->count; j > insertAt; --j)
-            {
-                hist->d[j].period = hist->d[j-1].period;
-                hist->d[j].count  = hist->d[j-1].count;
-            }
-            break;          /* terminate loop, following 'insert' code does the rest */
+        return;
+    }
+
+    differ = 0;
+    for (i = 1; i < count; ++i)
+        differ |= period[i] ^ period[0];
+
+    from = period;
+    to   = scratch;
+    for (shift = 0; shift < 8 * sizeof(tPeriod) && (differ >> shift) != 0; shift += 8)
+    {
+        if (((differ >> shift) & 0xFF) == 0)
+            continue;
+
+        memset(bucket, 0, sizeof(bucket));
+        for (i = 0; i < count; ++i)
+            ++bucket[ (from[i] >> shift) & 0xFF ];
+
+        for (sum = 0, i = 0; i < 256; ++i)
+        {
+            n = bucket[i];
+            bucket[i] = sum;
+            sum += n;
         }
+
+        for (i = 0; i < count; ++i)
+            to[ bucket[ (from[i] >> shift) & 0xFF ]++ ] = from[i];
+
+        swap = from; from = to; to = swap;
     }
-    if (insert) /* or append */
+
+    if (from != period)
+        memcpy(period, from, count * sizeof(tPeriod));
+}
+
+/*
+    Builds the histogram of a list of periods. Once sorted, equal periods
+    are adjacent, so it takes one pass. As the histogram used to be built
+    an insertion at a time, only the smallest MAX_HIST_SIZE-1 distinct
+    periods are kept.
+*/
+void buildRawHistogram(tRawHistogram *hist, tPeriod *period, tPeriod *scratch, size_t count)
+{
+    size_t  i;
+    tCount  n;
+
+    sortPeriods(period, scratch, count);
+
+    hist->count = 0;
+    i = 0;
+    while (i < count && hist->count < MAX_HIST_SIZE - 1)
     {
-        hist->d[insertAt].period = period;
-        hist->d[insertAt].count = 1;
-        if (hist->count < MAX_HIST_SIZE - 1)
-            ++hist->count;
+        n = 0;
+        hist->d[hist->count].period = period[i];
+        while (i < count && period[i] == hist->d[hist->count].period)
+        {
+            ++n;
+            ++i;
+        }
+        hist->d[hist->count].count = n;
+        ++hist->count;
     }
 }
 
@@ -413,7 +598,7 @@ int countFromHistogram(tHistogram *hist, int period)
 
     for (j = 0; j < hist->count; j++)
     {
-        if ( fuzzyMatch(hist->d[j].period, period, 100) )
+        if ( fuzzyMatch(hist->d[j].period, period, MATCH_TOLERANCE) )
             return hist->d[j].count;
     }
     return 0;
@@ -425,7 +610,7 @@ void incCountInHistogram(tHistogram *hist, int period)
 
     for (j = 0; j < hist->count; j++)
     {
-        if ( fuzzyMatch(hist->d[j].period, period, 100) )
+        if ( fuzzyMatch(hist->d[j].period, period, MATCH_TOLERANCE) )
         {
             ++hist->d[j].count;
             break;
@@ -434,19 +619,33 @@ void incCountInHistogram(tHistogram *hist, int period)
 }
 
 
-void analyzeIRStream(tIRStream *stream, tFingerprint *fingerprint)
+/* periods in each of a stream's histograms that fit on the stack - longer streams allocate */
+#define LOCAL_PERIODS   256
+
+void analyzeIRStream(tArena *arena, tIRStream *stream, tFingerprint *fingerprint)
 {
-    tRawHistogram   mark, space, *rhist;
+    tRawHistogram   mark, space;
     tHistogram      *hist;
-    tCount  i, last;
+    tPeriod localPeriods[3 * LOCAL_PERIODS], *periods, *markPeriods, *spacePeriods;
+    tCount  i, last, marks, spaces, total;
     int     period;
 
     /* build histograms of the periods in this IR stream */
     
-    mark.count = 0;
-    space.count = 0;
-    rhist = &mark;
     last = (stream->count - 2);
+    total = (last > 2) ? last - 2 : 0;
+
+    periods = localPeriods;
+    if (total > 2 * LOCAL_PERIODS)
+    {
+        periods = malloc( (total + total/2 + 1) * sizeof(tPeriod) );
+        if (periods == NULL)
+            fatalExit(-4, "unable to allocate memory to analyse a stream");
+    }
+    markPeriods  = periods;
+    spacePeriods = periods + (total + 1)/2;
+    marks  = 0;
+    spaces = 0;
 
     fingerprint->duration = stream->period[0];
     fingerprint->duration += stream->period[1];
@@ -455,16 +654,23 @@ void analyzeIRStream(tIRStream *stream, tFingerprint *fingerprint)
         period = stream->period[i];
         fingerprint->duration += period;
 
-        insertIntoSortedHistogram(rhist, toPeriod(period));
-
-        /* dumpHistogram((tHistogram *)hist); */
-        rhist = (rhist != &mark)? &mark : &space;
+        if ((i & 1) == 0)
+            markPeriods[marks++] = toPeriod(period);
+        else
+            spacePeriods[spaces++] = toPeriod(period);
     }
     fingerprint->duration += stream->period[i++]; /* last mark */
     fingerprint->duration += stream->period[i];   /* add in the inter-code gap */
 
-    fingerprint->mark  = normalizeRawHistogram(&mark);
-    fingerprint->space = normalizeRawHistogram(&space);
+    /* what follows the spaces is free for sorting */
+    buildRawHistogram( &mark,  markPeriods,  spacePeriods + spaces, marks );
+    buildRawHistogram( &space, spacePeriods, spacePeriods + spaces, spaces );
+
+    if (periods != localPeriods)
+        free(periods);
+
+    fingerprint->mark  = normalizeRawHistogram(arena, &mark);
+    fingerprint->space = normalizeRawHistogram(arena, &space);
     
     /* we now have a histogram of the 'meat' of the code, i.e. ignoring leading pair
        and trailing mark. Next determine if those are also valid symbols */
@@ -606,28 +812,22 @@ void analyzeIRStream(tIRStream *stream, tFingerprint *fingerprint)
     }
 }
 
-unsigned long normalizeFromReference( unsigned long *period, tReferenceHistogram refhist)
-{
-    int i;
-    for (i = 0; i < 4; ++i)
-    {
-        if (refhist[i] == 0)
-            break;
-
-        if ( fuzzyMatch(refhist[i], *period, 250) )
-        {
-            *period = refhist[i];
-            return *period;
-        }
-    }
-    return 0;
-}
+/* periods are snapped to the reference histograms this many at a time - must be even */
+#define ADJUST_BATCH    256
 
+/*
+    Every period is moved onto the reference period it matches, a batch at
+    a time. Then the leading pair may be replaced outright, and the last
+    space becomes whatever's left of the duration - the sum of the rest
+    comes from the same pass, rather than being kept as it goes.
+*/
 void adjustIRStream(tIRStream *stream, tFingerprint * UNUSED(fingerprint), tReferenceFingerprint *refprint, unsigned int *missed)
 {
-    unsigned long intracodeGap;
+    unsigned long sum;
     unsigned long *period;
-    tCount  count;
+    unsigned char matched[ADJUST_BATCH];
+    const tFuzzyBand *markBand, *spaceBand;
+    tCount  count, batch, i, j;
     
     count = stream->count;
     period = &stream->period[0];
@@ -641,77 +841,224 @@ void adjustIRStream(tIRStream *stream, tFingerprint * UNUSED(fingerprint), tRefe
 
     if (refprint != NULL)
     {
-        intracodeGap = refprint->duration;
+        markBand  = gProtocolIndex.band[refprint - gProtocol].mark;
+        spaceBand = gProtocolIndex.band[refprint - gProtocol].space;
 
-        if (count >= 2)
+        sum = 0;
+        for (i = 0; i < count; i += batch)
         {
-            if (refprint->leading.mark != 0)
-            {
-                *period = refprint->leading.mark;
-            }
-            else {
-                if (normalizeFromReference( period, refprint->mark) == 0)
-                {
-                    logDebug(0, "leading mark period %lu didn't normalize", *period);
-                    ++(*missed);
-                }
-            }
-            intracodeGap -= *period++;
-            --count;
+            batch = (count - i < ADJUST_BATCH) ? count - i : ADJUST_BATCH;
+            sum += snapPeriods( &period[i], batch, markBand, spaceBand, matched );
 
-            if (refprint->leading.space != 0)
+            for (j = 0; j < batch; ++j)
             {
-                *period = refprint->leading.space;
-            }
-            else {
-                if (normalizeFromReference( period, refprint->space) == 0)
-                {
-                    logDebug(0, "leading space period %lu didn't normalize", *period);
-                    ++(*missed);
-                }
+                if (matched[j] < REFERENCE_BANDS)
+                    continue;
+
+                /* these are replaced below, so never needed to match */
+                if ( (i + j == 0 && refprint->leading.mark != 0)
+                  || (i + j == 1 && refprint->leading.space != 0)
+                  || (i + j == count - 1 && i + j > 1) )
+                    continue;
+
+                logDebug(0, "%s%s period %lu didn't normalize",
+                            (i + j < 2) ? "leading " : "", ((i + j) & 1) ? "space" : "mark", period[i + j]);
+                ++(*missed);
             }
-            intracodeGap -= *period++;
-            --count;
         }
 
-        while (count > 0)
+        if (count >= 2)
         {
-            if (normalizeFromReference( period, refprint->mark) == 0)
+            if (refprint->leading.mark != 0)
             {
-                logDebug(0, "mark period %lu didn't normalize", *period);
-                ++(*missed);
+                sum += refprint->leading.mark - period[0];
+                period[0] = refprint->leading.mark;
             }
-            intracodeGap -= *period++;
-            --count;
-
-            if (count == 1)
+            if (refprint->leading.space != 0)
             {
-                *period++ = intracodeGap;
-            } 
-            else {
-                    
-                if (normalizeFromReference( period, refprint->space) == 0)
-                {
-                    logDebug(0, "space period %lu didn't normalize", *period);
-                    ++(*missed);
-                }
-                intracodeGap -= *period++;
+                sum += refprint->leading.space - period[1];
+                period[1] = refprint->leading.space;
             }
-            --count;
+        }
+        if (count > 2)
+        {
+            sum -= period[count - 1];
+            period[count - 1] = refprint->duration - sum;
         }
     }
 }
 
-void adjustIRCode(tIRCode *code)
+/*
+    Identical streams are shared between codes by the importer, so each
+    distinct stream is only analysed and adjusted once. This table has an
+    entry for every stream the codes being analysed point at.
+*/
+typedef struct {
+    tIRStream       *stream;        /* as imported. NULL if the slot is empty */
+    unsigned int    references;
+
+    tFingerprint    *analysed;      /* of the first code with this first/a stream, or NULL */
+    unsigned long   carrierFreq;    /* that code's, before adjustment changes it */
+
+    tReferenceFingerprint *adjustedFor;
+    tIRStream       *adjusted;      /* a copy, adjusted for the protocol above */
+    unsigned int    missed;
+} tStreamEntry;
+
+static struct {
+    tStreamEntry    *table;
+    size_t          size;       /* a power of two, with room for a quarter more than the entries */
+} gStreams;
+
+/* one per analysis thread */
+typedef struct {
+    pthread_t       thread;
+    pthread_mutex_t lock;       /* guards next and end - idle workers steal from the end */
+    size_t          next, end;  /* the part of gStore.codes still to be analysed */
+    tArena          arena;      /* histograms and adjusted streams - adopted by gArena afterwards */
+    int             *matched;   /* per gProtocol[] entry, merged into .matched afterwards */
+    unsigned long long adjustTime;  /* microseconds spent adjusting - only timed for --stats */
+} tWorker;
+
+static struct {
+    tWorker         *workers;
+    int             workerCount;
+} gWork;
+
+/* shared streams may be reached from several workers at once - striped, rather than one lock each */
+#define STREAM_LOCKS    64
+static pthread_mutex_t gStreamLocks[STREAM_LOCKS];
+
+static int lockStream(tStreamEntry *entry)
+{
+    if (gWork.workerCount < 2 || entry->references < 2)
+        return 0;
+
+    pthread_mutex_lock( &gStreamLocks[ (entry - gStreams.table) % STREAM_LOCKS ] );
+    return 1;
+}
+
+static void unlockStream(tStreamEntry *entry, int locked)
+{
+    if (locked)
+        pthread_mutex_unlock( &gStreamLocks[ (entry - gStreams.table) % STREAM_LOCKS ] );
+}
+
+/* as identifyProtocol() used to - NULL counts against the list end */
+void countMatch(tWorker *worker, tReferenceFingerprint *protocol)
+{
+    if (protocol == NULL)
+        ++worker->matched[ protocolCount() ];
+    else
+        ++worker->matched[ protocol - gProtocol ];
+}
+
+static tStreamEntry *findStream(tIRStream *stream)
+{
+    size_t  i;
+
+    i = ((size_t)stream >> 4) * 0x9E3779B97F4A7C15ULL;
+    for (i &= gStreams.size - 1; ; i = (i + 1) & (gStreams.size - 1))
+    {
+        if (gStreams.table[i].stream == stream || gStreams.table[i].stream == NULL)
+            return &gStreams.table[i];
+    }
+}
+
+static void addStream(tIRStream *stream)
+{
+    tStreamEntry *entry;
+
+    if (stream == NULL)
+        return;
+
+    entry = findStream(stream);
+    entry->stream = stream;
+    ++entry->references;
+}
+
+/* for gStore.codes[first, end) */
+static void buildStreamTable(size_t first, size_t end)
+{
+    tIRCode     *code;
+    size_t      i, count = 0;
+
+    for (i = first; i < end; ++i)
+    {
+        code = &gStore.codes[i];
+        count += (code->first.a  != NULL) + (code->first.b  != NULL)
+               + (code->repeat.a != NULL) + (code->repeat.b != NULL);
+    }
+
+    for (gStreams.size = 16; gStreams.size < count + count / 4; gStreams.size *= 2)
+        { }
+    gStreams.table = calloc(gStreams.size, sizeof(tStreamEntry));
+    if (gStreams.table == NULL)
+        fatalExit(-4, "unable to allocate the stream table");
+
+    for (i = first; i < end; ++i)
+    {
+        code = &gStore.codes[i];
+        addStream(code->first.a);
+        addStream(code->first.b);
+        addStream(code->repeat.a);
+        addStream(code->repeat.b);
+    }
+}
+
+static void releaseStreamTable(void)
+{
+    free(gStreams.table);
+    gStreams.table = NULL;
+    gStreams.size  = 0;
+}
+
+/*
+    A stream that's only used once is adjusted in place, as before. A shared
+    one is copied first, as the codes sharing it needn't share a protocol.
+*/
+void adjustSharedIRStream(tArena *arena, tIRStream **stream, tFingerprint *fingerprint, tReferenceFingerprint *refprint, unsigned int *missed)
+{
+    tStreamEntry    *entry;
+    size_t          size;
+    int             locked;
+
+    entry = findStream(*stream);
+    if (entry->references < 2)
+    {
+        adjustIRStream(*stream, fingerprint, refprint, missed);
+        return;
+    }
+
+    locked = lockStream(entry);
+    if (entry->adjusted == NULL || entry->adjustedFor != refprint)
+    {
+        size = sizeof(tIRStream) + (*stream)->count * sizeof(unsigned long);
+        entry->adjusted = arenaAlloc( arena, size );
+        if (entry->adjusted == NULL)
+            fatalExit(-4, "unable to allocate an adjusted stream");
+
+        memcpy( entry->adjusted, *stream, size );
+        entry->adjustedFor = refprint;
+        entry->missed = 0;
+        adjustIRStream(entry->adjusted, fingerprint, refprint, &entry->missed);
+    }
+
+    *missed += entry->missed;
+    *stream = entry->adjusted;
+    unlockStream(entry, locked);
+}
+
+void adjustIRCode(tArena *arena, tIRCode *code)
 {
     tFingerprint            *fingerprint = &code->fingerprint;
     tReferenceFingerprint   *refprint    = fingerprint->protocol;
     unsigned int            missed;
     
     missed = 0;
-    adjustIRStream( code->first.a, fingerprint, refprint, &missed );
+    adjustSharedIRStream( arena, &code->first.a, fingerprint, refprint, &missed );
     if ( code->first.b != NULL )
-        adjustIRStream( code->first.b, fingerprint, refprint, &missed );
+        adjustSharedIRStream( arena, &code->first.b, fingerprint, refprint, &missed );
 
     if (refprint != NULL)
     {
@@ -719,23 +1066,16 @@ void adjustIRCode(tIRCode *code)
         {
         case kUnknownRepeatStream:
             if ( code->repeat.a != NULL )
-                adjustIRStream( code->repeat.a, fingerprint, refprint, &missed );
+                adjustSharedIRStream( arena, &code->repeat.a, fingerprint, refprint, &missed );
 
             if ( code->repeat.b != NULL )
-                adjustIRStream( code->repeat.b, fingerprint, refprint, &missed );
+                adjustSharedIRStream( arena, &code->repeat.b, fingerprint, refprint, &missed );
             break;
 
         default:
-            if (code->repeat.a != NULL)
-                free( code->repeat.a );
-                
+            /* the streams being replaced belong to gArena, so are simply dropped */
             code->repeat.a = (tIRStream *)&gRepeatStream[refprint->repeatStream];
-
-            if (code->repeat.b != NULL)
-            {
-                free( code->repeat.b );
-                code->repeat.b = NULL;
-            }
+            code->repeat.b = NULL;
             break;
         }
     
@@ -743,34 +1083,83 @@ void adjustIRCode(tIRCode *code)
     }
 
     if (missed != 0)
-        logWarning("%u periods didn't normalize (on line %d)", missed, code->lineNumber );
+        logWarning("%u periods didn't normalize (on line %d)", missed, labelOf(code)->lineNumber );
 }
 
-void analyzeIRCode(tIRCode *code)
+void analyzeIRCode(tWorker *worker, tIRCode *code)
 {
     tFingerprint    *fingerprint;
     tIRStream       *stream = NULL;
+    tStreamEntry    *entry;
+    tIRCodeSet      *codeSet;
+    tIRCodeLabel    *label;
+    int             locked;
+    unsigned long long start;
 
     if (code == NULL) return;
     
     fingerprint = &code->fingerprint;
+    codeSet     = codeSetOf(code);
+    label       = labelOf(code);
+
+    if ((size_t)(code - gStore.codes) == codeSet->firstCode)
+    {
+        logDebug(1, "Set %d (%s %s)",
+                    codeSet->id,
+                    gBrandName[codeSet->brand],
+                    gDeviceTypeName[codeSet->deviceType] );
+    }
 
     if (code->first.a != NULL)
     {
         stream = code->first.a;
+        entry  = findStream(stream);
+        locked = lockStream(entry);
 
-        analyzeIRStream(code->first.a, fingerprint);
-    }   
+        if (entry->analysed != NULL && entry->carrierFreq == fingerprint->carrierFreq)
+        {
+            /* an earlier code has the same stream - the histograms are only read from here on */
+            fingerprint->encoding    = entry->analysed->encoding;
+            fingerprint->symbolCount = entry->analysed->symbolCount;
+            fingerprint->leading     = entry->analysed->leading;
+            fingerprint->trailing    = entry->analysed->trailing;
+            fingerprint->duration    = entry->analysed->duration;
+            fingerprint->mark        = entry->analysed->mark;
+            fingerprint->space       = entry->analysed->space;
+            fingerprint->protocol    = entry->analysed->protocol;
+        }
+        else
+        {
+            if ( !lookupFingerprint( code->first.a, fingerprint ) )
+            {
+                analyzeIRStream(&worker->arena, code->first.a, fingerprint);
+
+                fingerprint->protocol = identifyProtocol( fingerprint );
+
+                /* before adjustIRCode() rewrites the stream */
+                storeFingerprint( code->first.a, fingerprint );
+            }
+            entry->analysed    = fingerprint;
+            entry->carrierFreq = fingerprint->carrierFreq;
+        }
+        unlockStream(entry, locked);
+    }
+    else fingerprint->protocol = identifyProtocol( fingerprint );
 
-    fingerprint->protocol = identifyProtocol( fingerprint );
+    countMatch( worker, fingerprint->protocol );
+
+    /* keep each code's diagnostics together when other workers are logging too */
+    if (logDebugEnabled(0))
+        lockLog();
 
     if (fingerprint->protocol != NULL)
     {
-        logDebug( 1, "Set %d (%s %s) - %s - protocol: %s",
-                    code->parent->id,
-                    gBrandName[code->parent->brand],
-                    gDeviceTypeName[code->parent->deviceType],
-                    code->button.label, fingerprint->protocol->name );
+        logDebug( 1, "Set %d (%s %s) - %.*s - protocol: %s",
+                    codeSet->id,
+                    gBrandName[codeSet->brand],
+                    gDeviceTypeName[codeSet->deviceType],
+                    (int)label->labelLength, label->label,
+                    fingerprint->protocol->name );
         if (logDebugEnabled(2))
         {
             dumpIRCode(code);
@@ -779,7 +1168,13 @@ void analyzeIRCode(tIRCode *code)
         {
         case kFromSpec:
         case kMeasured:
-            adjustIRCode(code);
+            if (statsEnabled())
+            {
+                start = statsClock();
+                adjustIRCode(&worker->arena, code);
+                worker->adjustTime += statsClock() - start;
+            }
+            else adjustIRCode(&worker->arena, code);
             if (logDebugEnabled(2))
             {
                 logDebug(2, "######## After Adjustment ########");
@@ -792,39 +1187,163 @@ void analyzeIRCode(tIRCode *code)
         }
     }
     else {
-        logError( "Set %d (%s %s) - %s - ### protocol not identified ###",
-                    code->parent->id,
-                    gBrandName[code->parent->brand],
-                    gDeviceTypeName[code->parent->deviceType],
-                    code->button.label );
+        logError( "Set %d (%s %s) - %.*s - ### protocol not identified ###",
+                    codeSet->id,
+                    gBrandName[codeSet->brand],
+                    gDeviceTypeName[codeSet->deviceType],
+                    (int)label->labelLength, label->label );
         if (logDebugEnabled(0))
         {
             dumpIRCode(code);
         }
     }
+
+    if (logDebugEnabled(0))
+        unlockLog();
 }
 
-void analyzeIRCodeSets(void)
+/* take the back half of another worker's codes. Returns zero if there's nothing left anywhere */
+static int stealWork(tWorker *thief)
 {
-    tIRCodeSet  *codeSet;
-    tIRCode     *code;
+    tWorker *victim;
+    size_t  next = 0, end = 0;
+    int     i;
 
-    codeSet = gIRCodeSets;
-    
-    while (codeSet != NULL)
+    for (i = 1; i < gWork.workerCount && next == end; ++i)
     {
-        logDebug(1, "Set %d (%s %s)",
-                    codeSet->id,
-                    gBrandName[codeSet->brand],
-                    gDeviceTypeName[codeSet->deviceType] );
+        victim = &gWork.workers[ ((thief - gWork.workers) + i) % gWork.workerCount ];
+
+        pthread_mutex_lock( &victim->lock );
+        if (victim->next < victim->end)
+        {
+            end  = victim->end;
+            next = end - (victim->end - victim->next + 1) / 2;
+            victim->end = next;
+        }
+        pthread_mutex_unlock( &victim->lock );
+    }
+
+    if (next == end)
+        return 0;
+
+    pthread_mutex_lock( &thief->lock );
+    thief->next = next;
+    thief->end  = end;
+    pthread_mutex_unlock( &thief->lock );
+
+    return 1;
+}
 
-        code = codeSet->irCodes;
-        while (code != NULL)
+static void *analysisWorker(void *arg)
+{
+    tWorker *worker = arg;
+    tIRCode *code;
+
+    for (;;)
+    {
+        pthread_mutex_lock( &worker->lock );
+        code = (worker->next < worker->end) ? &gStore.codes[ worker->next++ ] : NULL;
+        pthread_mutex_unlock( &worker->lock );
+
+        if (code != NULL)
+            analyzeIRCode(worker, code);
+        else if ( !stealWork(worker) )
+            break;
+    }
+    return NULL;
+}
+
+/*
+    Analyse gStore.codes[first, end). The codes are dealt out to the
+    workers in contiguous runs, and a worker that runs out steals half of
+    what another has left - so a few huge code sets can't leave threads idle.
+    Each worker has its own arena and match counters, so nothing but the
+    shared streams needs a lock.
+*/
+void analyzeIRCodeRange(size_t first, size_t end, int threadCount)
+{
+    tWorker     *worker;
+    size_t      i, total;
+    int         w, count;
+    unsigned long long adjustTime, longestAdjust;
+
+    buildProtocolIndex();
+    buildStreamTable(first, end);
+
+    total = end - first;
+    if (threadCount < 1)
+        threadCount = 1;
+    if ((size_t)threadCount > total)
+        threadCount = (total > 0) ? total : 1;
+
+    count = protocolCount();
+    gWork.workerCount = threadCount;
+    gWork.workers = calloc( threadCount, sizeof(tWorker) );
+    if (gWork.workers == NULL)
+        fatalExit(-4, "unable to allocate the analysis workers");
+
+    for (w = 0; w < threadCount; ++w)
+    {
+        worker = &gWork.workers[w];
+        pthread_mutex_init( &worker->lock, NULL );
+        worker->next = first + (total * w) / threadCount;
+        worker->end  = first + (total * (w + 1)) / threadCount;
+        worker->matched = calloc( count + 1, sizeof(int) );
+        if (worker->matched == NULL)
+            fatalExit(-4, "unable to allocate the analysis workers");
+    }
+    for (w = 0; w < STREAM_LOCKS; ++w)
+        pthread_mutex_init( &gStreamLocks[w], NULL );
+
+    /* the last worker runs on this thread */
+    for (w = 0; w < threadCount; ++w)
+    {
+        worker = &gWork.workers[w];
+        if (w == threadCount - 1 || pthread_create( &worker->thread, NULL, analysisWorker, worker ) != 0)
         {
-            analyzeIRCode(code);
-            code = code->next;
+            worker->thread = pthread_self();
+            analysisWorker( worker );
         }
-        codeSet = codeSet->next;
     }
+
+    adjustTime = longestAdjust = 0;
+    for (w = 0; w < threadCount; ++w)
+    {
+        worker = &gWork.workers[w];
+        if ( !pthread_equal( worker->thread, pthread_self() ) )
+            pthread_join( worker->thread, NULL );
+
+        for (i = 0; i <= (size_t)count; ++i)
+            gProtocol[i].matched += worker->matched[i];
+
+        adjustTime += worker->adjustTime;
+        if (worker->adjustTime > longestAdjust)
+            longestAdjust = worker->adjustTime;
+
+        arenaAdopt( &gArena, &worker->arena );
+        pthread_mutex_destroy( &worker->lock );
+        free( worker->matched );
+    }
+    for (w = 0; w < STREAM_LOCKS; ++w)
+        pthread_mutex_destroy( &gStreamLocks[w] );
+
+    countAdjustment( adjustTime, longestAdjust );
+
+    free( gWork.workers );
+    gWork.workers = NULL;
+    gWork.workerCount = 0;
+
+    releaseStreamTable();
+}
+
+void analyzeIRCodeSet(tIRCodeSet *codeSet)
+{
+    analyzeIRCodeRange(codeSet->firstCode, codeSet->firstCode + codeSet->codeCount, 1);
+}
+
+void analyzeIRCodeSets(int threadCount)
+{
+    analyzeIRCodeRange(0, gStore.codeCount, threadCount);
+
     dumpFingerprintStats();
 }
@@ -6,6 +6,26 @@
     Copyright 2011, Paul Chambers. All Rights Reserved.
 */
 
-void analyzeIRCodeSets(void);
+/* how close two periods must be to count as the same symbol, in tenths of a percent */
+#define MATCH_TOLERANCE     100
+
+/* how close a period must be to a protocol's reference period to be adjusted to it */
+#define ADJUST_TOLERANCE    250
+
+extern tReferenceFingerprint gProtocol[];
+
+void analyzeIRCodeSets(int threadCount);
+void analyzeIRCodeSet(tIRCodeSet *codeSet);
+void dumpFingerprintStats(void);
+
+/* the kernels of the analysis - also timed on their own by microbench */
+tPeriod toPeriod(unsigned long x);
+int fuzzyMatch(unsigned long reference, unsigned long value, unsigned int threshold);
+void buildProtocolIndex(void);
+void buildRawHistogram(tRawHistogram *hist, tPeriod *period, tPeriod *scratch, size_t count);
+tHistogram *normalizeRawHistogram(tArena *arena, tRawHistogram *hist);
+void analyzeIRStream(tArena *arena, tIRStream *stream, tFingerprint *fingerprint);
+tReferenceFingerprint *identifyProtocol(tFingerprint *fingerprint);
+void adjustIRStream(tIRStream *stream, tFingerprint *fingerprint, tReferenceFingerprint *refprint, unsigned int *missed);
 
 
@@ -0,0 +1,125 @@
+/*
+    @file arena.c
+
+    Region allocator for the imported database - the code sets, codes,
+    streams, labels and histograms are all allocated once and live until
+    the end of the run, so there's no point paying for individual malloc/free.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE    (1024 * 1024)
+#define ARENA_ALIGN         16
+#define ARENA_HEADER_SIZE   ((sizeof(tArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static tArenaBlock *newBlock(tArena *arena, size_t size)
+{
+    tArenaBlock *block;
+
+    if (size < ARENA_BLOCK_SIZE)
+        size = ARENA_BLOCK_SIZE;
+
+    /* calloc'd memory is already zeroed (and usually untouched until used) */
+    block = calloc(1, ARENA_HEADER_SIZE + size);
+    if (block != NULL)
+    {
+        block->size = size;
+        block->used = 0;
+        block->data = (char *)block + ARENA_HEADER_SIZE;
+
+        block->next   = arena->blocks;
+        arena->blocks = block;
+    }
+    return block;
+}
+
+void *arenaAlloc(tArena *arena, size_t size)
+{
+    tArenaBlock *block;
+    void        *result;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    block = arena->blocks;
+    if (block == NULL || block->size - block->used < size)
+    {
+        block = newBlock(arena, size);
+        if (block == NULL)
+        {
+            logErrorErrno("unable to allocate %lu bytes", (unsigned long)size);
+            return NULL;
+        }
+    }
+
+    result = block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+char *arenaStrndup(tArena *arena, const char *str, size_t length)
+{
+    char *result;
+
+    result = arenaAlloc(arena, length + 1);
+    if (result != NULL)
+        memcpy(result, str, length);    /* already terminated */
+
+    return result;
+}
+
+void arenaAdopt(tArena *dest, tArena *src)
+{
+    tArenaBlock *last;
+
+    if (src->blocks == NULL)
+        return;
+
+    /* src's blocks go after dest's current block, so that keeps filling */
+    for (last = src->blocks; last->next != NULL; last = last->next)
+        { }
+
+    if (dest->blocks == NULL)
+    {
+        dest->blocks = src->blocks;
+    }
+    else
+    {
+        last->next = dest->blocks->next;
+        dest->blocks->next = src->blocks;
+    }
+    src->blocks = NULL;
+}
+
+void arenaReset(tArena *arena)
+{
+    tArenaBlock *block;
+
+    block = arena->blocks;
+    if (block != NULL)
+    {
+        arena->blocks = block->next;
+        block->next = NULL;
+        arenaRelease(arena);
+
+        /* arenaAlloc promises zeroed memory */
+        memset(block->data, 0, block->used);
+        block->used = 0;
+        arena->blocks = block;
+    }
+}
+
+void arenaRelease(tArena *arena)
+{
+    tArenaBlock *block, *next;
+
+    for (block = arena->blocks; block != NULL; block = next)
+    {
+        next = block->next;
+        free(block);
+    }
+    arena->blocks = NULL;
+}
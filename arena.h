@@ -0,0 +1,42 @@
+/*
+    @file arena.h
+
+    A simple region allocator. Memory is handed out by bumping a pointer
+    through large blocks, and is only ever released all at once.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+#ifndef __MY_ARENA__
+#define __MY_ARENA__
+
+typedef struct tArenaBlock
+{
+    struct tArenaBlock *next;
+    size_t  size;       /* bytes available in data[] */
+    size_t  used;
+    char    *data;
+
+} tArenaBlock;
+
+typedef struct
+{
+    tArenaBlock *blocks;    /* most recently allocated first */
+
+} tArena;
+
+#define ARENA_INITIALIZER   { NULL }
+
+/* returns zeroed memory, or NULL if out of memory */
+void *arenaAlloc(tArena *arena, size_t size);
+char *arenaStrndup(tArena *arena, const char *str, size_t length);
+
+/* move all of src's blocks into dest, leaving src empty */
+void arenaAdopt(tArena *dest, tArena *src);
+
+/* discard everything allocated from the arena, but keep a block for re-use */
+void arenaReset(tArena *arena);
+
+/* free everything allocated from the arena */
+void arenaRelease(tArena *arena);
+
+#endif
@@ -0,0 +1,422 @@
+/*
+    @file binarydb.c
+
+    The binary database is laid out as columns, each section aligned to
+    eight bytes:
+
+        header
+        code sets   - one tBinaryCodeSet per code set, in input order
+        codes       - one tBinaryCode per code, grouped by code set
+        periods     - every distinct stream, one after another, each laid out
+                      exactly as a tIRStream (count, then the periods). A
+                      stream that more than one code points at is only
+                      stored once
+        labels      - every button label, back to back, not terminated
+
+    Streams are stored in the machine's own word size and byte order, so
+    the loader can map the file and point the tIRCodes straight at them.
+    The mapping is private, so adjusting the streams doesn't write back.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "analyse-ir-codes.h"
+#include "binarydb.h"
+#include "store.h"
+#include "stats.h"
+
+#define BINARY_DB_MAGIC     "IRDB"
+#define BINARY_DB_VERSION   2
+#define BINARY_DB_ORDER     0x01020304
+#define BINARY_NO_STREAM    UINT64_MAX
+
+#define ALIGN8(x)   (((x) + 7) & ~(uint64_t)7)
+
+typedef struct {
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    byteOrder;      /* BINARY_DB_ORDER, as written by this machine */
+    uint32_t    wordSize;       /* sizeof(unsigned long) */
+    uint32_t    deviceTypeCount;    /* so a change to the mapping tables is noticed */
+    uint32_t    brandCount;
+
+    uint64_t    codeSetCount;
+    uint64_t    codeCount;
+    uint64_t    periodWords;    /* size of the period section, in unsigned longs */
+    uint64_t    labelBytes;
+
+    /* byte offsets from the start of the file */
+    uint64_t    codeSetOffset;
+    uint64_t    codeOffset;
+    uint64_t    periodOffset;
+    uint64_t    labelOffset;
+} tBinaryHeader;
+
+typedef struct {
+    uint32_t    id;
+    uint32_t    deviceType;
+    uint32_t    brand;
+    uint32_t    codeCount;
+} tBinaryCodeSet;
+
+typedef struct {
+    uint64_t    carrierFreq;    /* as wide as any unsigned long */
+    uint32_t    repeatType;
+    uint32_t    lineNumber;
+    uint32_t    labelLength;
+    uint32_t    unused;
+    uint64_t    labelOffset;    /* into the label section */
+    uint64_t    stream[4];      /* word offset into the period section, or BINARY_NO_STREAM */
+} tBinaryCode;
+
+/* in the order they're stored in tBinaryCode.stream[] */
+tIRStream **binaryStream(tIRCode *code, int i)
+{
+    switch (i)
+    {
+    case 0:  return &code->first.a;
+    case 1:  return &code->first.b;
+    case 2:  return &code->repeat.a;
+    default: return &code->repeat.b;
+    }
+}
+
+/* a stream shared between codes is only written once - keyed on its address */
+typedef struct {
+    const tIRStream *stream;
+    uint64_t        offset;     /* word offset into the period section */
+} tSharedStream;
+
+static struct {
+    tSharedStream   *table;
+    size_t          mask;
+} gShared;
+
+/* returns the slot the stream is in, or should go in */
+static tSharedStream *findSharedStream(const tIRStream *stream)
+{
+    size_t  i;
+
+    i = ((uintptr_t)stream >> 3) * 0x9E3779B9U;
+    for (;;)
+    {
+        i &= gShared.mask;
+        if (gShared.table[i].stream == NULL || gShared.table[i].stream == stream)
+            return &gShared.table[i];
+        ++i;
+    }
+}
+
+/* pad a section of the given length out to the next 8 byte boundary */
+void writePadding(FILE *file, uint64_t length)
+{
+    static const char padding[8] = { 0 };
+
+    fwrite(padding, 1, ALIGN8(length) - length, file);
+}
+
+int exportBinaryDB( FILE * file )
+{
+    tBinaryHeader   header;
+    tBinaryCodeSet  set;
+    tBinaryCode     record;
+    tIRCodeSet      *codeSet;
+    tIRCode         *code;
+    tIRCodeLabel    *label;
+    tIRStream       *stream;
+    tSharedStream   *slot;
+    uint64_t        periodWords, labelBytes;
+    size_t          c, size;
+    int             i;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_DB_MAGIC, sizeof(header.magic));
+    header.version          = BINARY_DB_VERSION;
+    header.byteOrder        = BINARY_DB_ORDER;
+    header.wordSize         = sizeof(unsigned long);
+    header.deviceTypeCount  = kDeviceTypeMax;
+    header.brandCount       = kBrandMax;
+
+    for (size = 16; size < 8 * gStore.codeCount; size <<= 1)
+        { }
+    gShared.table = calloc(size, sizeof(tSharedStream));
+    if (gShared.table == NULL)
+        fatalExit(-4, "unable to allocate the shared stream table");
+    gShared.mask = size - 1;
+
+    /* first pass - size everything up, and lay out each distinct stream */
+    header.codeSetCount = gStore.codeSetCount;
+    header.codeCount    = gStore.codeCount;
+    for (c = 0; c < gStore.codeCount; ++c)
+    {
+        header.labelBytes += gStore.labels[c].labelLength;
+        for (i = 0; i < 4; ++i)
+        {
+            stream = *binaryStream(&gStore.codes[c], i);
+            if (stream == NULL)
+                continue;
+
+            slot = findSharedStream(stream);
+            if (slot->stream == NULL)
+            {
+                slot->stream = stream;
+                slot->offset = header.periodWords;
+                header.periodWords += 1 + stream->count;
+            }
+        }
+    }
+
+    header.codeSetOffset = ALIGN8(sizeof(header));
+    header.codeOffset    = header.codeSetOffset + ALIGN8(header.codeSetCount * sizeof(tBinaryCodeSet));
+    header.periodOffset  = header.codeOffset    + ALIGN8(header.codeCount * sizeof(tBinaryCode));
+    header.labelOffset   = header.periodOffset  + ALIGN8(header.periodWords * sizeof(unsigned long));
+
+    fwrite(&header, sizeof(header), 1, file);
+    writePadding(file, sizeof(header));
+
+    for (c = 0; c < gStore.codeSetCount; ++c)
+    {
+        codeSet = &gStore.codeSets[c];
+        memset(&set, 0, sizeof(set));
+        set.id         = codeSet->id;
+        set.deviceType = codeSet->deviceType;
+        set.brand      = codeSet->brand;
+        set.codeCount  = codeSet->codeCount;
+
+        fwrite(&set, sizeof(set), 1, file);
+    }
+    writePadding(file, header.codeSetCount * sizeof(tBinaryCodeSet));
+
+    labelBytes  = 0;
+    for (c = 0; c < gStore.codeCount; ++c)
+    {
+        code  = &gStore.codes[c];
+        label = &gStore.labels[c];
+
+        memset(&record, 0, sizeof(record));
+        record.carrierFreq = code->fingerprint.carrierFreq;
+        record.repeatType  = code->fingerprint.repeatType;
+        record.lineNumber  = label->lineNumber;
+        record.labelLength = label->labelLength;
+        record.labelOffset = labelBytes;
+        labelBytes += label->labelLength;
+
+        for (i = 0; i < 4; ++i)
+        {
+            stream = *binaryStream(code, i);
+            record.stream[i] = BINARY_NO_STREAM;
+            if (stream != NULL)
+                record.stream[i] = findSharedStream(stream)->offset;
+        }
+        fwrite(&record, sizeof(record), 1, file);
+    }
+    writePadding(file, header.codeCount * sizeof(tBinaryCode));
+
+    /* streams, in the order they were laid out. Shared ones were only laid out the first time */
+    periodWords = 0;
+    for (c = 0; c < gStore.codeCount; ++c)
+    {
+        for (i = 0; i < 4; ++i)
+        {
+            stream = *binaryStream(&gStore.codes[c], i);
+            if (stream == NULL || findSharedStream(stream)->offset != periodWords)
+                continue;
+
+            fwrite(stream, sizeof(unsigned long), 1 + stream->count, file);
+            periodWords += 1 + stream->count;
+        }
+    }
+    free(gShared.table);
+    gShared.table = NULL;
+
+    writePadding(file, header.periodWords * sizeof(unsigned long));
+
+    for (c = 0; c < gStore.codeCount && !ferror(file); ++c)
+    {
+        fwrite(gStore.labels[c].label, 1, gStore.labels[c].labelLength, file);
+    }
+
+    if (fflush(file) != 0 || ferror(file))
+    {
+        logDebugErrno(0, "error writing to output");
+        return (-3);
+    }
+    countBytesWritten( header.labelOffset + header.labelBytes );
+    return (0);
+}
+
+/*
+    Does a section of count elements of the given size, starting at offset,
+    end at or before limit? Checked without anything wrapping, as the
+    counts and offsets come from the file.
+*/
+static int sectionFits(uint64_t offset, uint64_t count, uint64_t size, uint64_t limit)
+{
+    return ( offset <= limit
+          && (offset & 7) == 0
+          && count <= (limit - offset) / size );
+}
+
+/*
+    Fill in the store from the mapped file, whose header has been checked.
+    Returns -3 at the first bad record, with the store part-built.
+*/
+static int addBinaryCodes( char *base, const tBinaryHeader *header )
+{
+    const tBinaryCodeSet *set;
+    const tBinaryCode   *record;
+    unsigned long       *periods;
+    tIRCodeSet          *codeSet;
+    tIRCode             *code;
+    tIRCodeLabel        *label;
+    tIRStream           *stream;
+    uint64_t            i, j;
+    int                 k;
+
+    set     = (const tBinaryCodeSet *)(base + header->codeSetOffset);
+    record  = (const tBinaryCode *)(base + header->codeOffset);
+    periods = (unsigned long *)(base + header->periodOffset);
+
+    for (i = 0; i < header->codeSetCount; ++i, ++set)
+    {
+        /* they index the name tables */
+        if (set->deviceType >= kDeviceTypeMax || set->brand >= kBrandMax)
+        {
+            logError("binary input has a bad device type or brand in code set %u", set->id);
+            return (-3);
+        }
+
+        codeSet = addCodeSet( &gStore );
+        codeSet->id         = set->id;
+        codeSet->deviceType = set->deviceType;
+        codeSet->brand      = set->brand;
+
+        if ( gStore.codeCount + set->codeCount > header->codeCount )
+        {
+            logError("binary input has inconsistent code counts");
+            return (-3);
+        }
+
+        for (j = 0; j < set->codeCount; ++j, ++record)
+        {
+            if (record->repeatType > kToggleRepeat)
+            {
+                logError("binary input has a bad repeat type on line %u", record->lineNumber);
+                return (-3);
+            }
+
+            code  = addCode( &gStore );
+            label = &gStore.labels[gStore.codeCount - 1];
+            label->lineNumber = record->lineNumber;
+            code->fingerprint.carrierFreq = record->carrierFreq;
+            code->fingerprint.repeatType  = record->repeatType;
+
+            if ( record->labelOffset > header->labelBytes
+              || record->labelLength > header->labelBytes - record->labelOffset )
+            {
+                logError("binary input has a bad label on line %u", record->lineNumber);
+                return (-3);
+            }
+            label->label       = base + header->labelOffset + record->labelOffset;
+            label->labelLength = record->labelLength;
+
+            for (k = 0; k < 4; ++k)
+            {
+                if (record->stream[k] == BINARY_NO_STREAM)
+                    continue;
+
+                /* the count must be inside the section before it can be read */
+                if ( record->stream[k] >= header->periodWords )
+                {
+                    logError("binary input has a bad stream on line %u", record->lineNumber);
+                    return (-3);
+                }
+                /* analyzeIRStream() needs at least the leading pair and a trailing pair -
+                   and the text importer never makes one longer than MAX_RAW_IR_COUNT */
+                stream = (tIRStream *)&periods[ record->stream[k] ];
+                if ( stream->count >= header->periodWords - record->stream[k]
+                  || stream->count < 4 || stream->count > MAX_RAW_IR_COUNT )
+                {
+                    logError("binary input has a bad stream on line %u", record->lineNumber);
+                    return (-3);
+                }
+                *binaryStream(code, k) = stream;
+            }
+        }
+    }
+
+    return (0);
+}
+
+/*
+    Map the file and fill in the store from it. The only work per record is
+    copying a few fields - streams and labels are used in place.
+*/
+int importBinaryDB( FILE * file )
+{
+    struct stat         info;
+    char                *base;
+    const tBinaryHeader *header;
+
+    if ( fstat( fileno(file), &info ) != 0 || !S_ISREG( info.st_mode ) )
+    {
+        logError("binary input must be a regular file");
+        return (-3);
+    }
+
+    if ( (size_t)info.st_size < sizeof(tBinaryHeader) )
+    {
+        logError("binary input is truncated");
+        return (-3);
+    }
+
+    base = mmap( NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0 );
+    if ( base == MAP_FAILED )
+    {
+        logErrorErrno("unable to map binary input");
+        return (-3);
+    }
+    countBytesRead( info.st_size );
+
+    header = (const tBinaryHeader *)base;
+    if ( memcmp( header->magic, BINARY_DB_MAGIC, sizeof(header->magic) ) != 0
+      || header->version   != BINARY_DB_VERSION )
+    {
+        logError("input is not a binary IR database");
+        return (-3);
+    }
+    if ( header->byteOrder != BINARY_DB_ORDER || header->wordSize != sizeof(unsigned long) )
+    {
+        logError("binary input was written by an incompatible machine");
+        return (-3);
+    }
+    if ( header->deviceTypeCount != kDeviceTypeMax || header->brandCount != kBrandMax )
+    {
+        logError("binary input was written with different brand/device type tables");
+        return (-3);
+    }
+    /* each section must end before the next one starts, and the last one within the file */
+    if ( header->codeSetOffset < sizeof(tBinaryHeader)
+      || !sectionFits( header->codeSetOffset, header->codeSetCount, sizeof(tBinaryCodeSet), header->codeOffset )
+      || !sectionFits( header->codeOffset,    header->codeCount,    sizeof(tBinaryCode),    header->periodOffset )
+      || !sectionFits( header->periodOffset,  header->periodWords,  sizeof(unsigned long),  header->labelOffset )
+      || !sectionFits( header->labelOffset,   header->labelBytes,   1,                      (uint64_t)info.st_size ) )
+    {
+        logError("binary input is truncated or corrupt");
+        return (-3);
+    }
+
+    /* nothing half-built is left behind - the caller doesn't go on with a broken store */
+    if ( addBinaryCodes( base, header ) != 0 )
+    {
+        releaseCodeStore( &gStore );
+        return (-3);
+    }
+    return (0);
+}
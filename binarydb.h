@@ -0,0 +1,12 @@
+/*
+    @file binarydb.h
+
+    A compact binary form of the database, which can be loaded without
+    parsing anything.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+int importBinaryDB(FILE *inputFile);
+int exportBinaryDB(FILE *outputFile);
+
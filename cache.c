@@ -0,0 +1,525 @@
+/*
+    @file cache.c
+
+    A persistent cache of fingerprints, so codes that haven't changed since
+    the last run skip analyzeIRStream() and identifyProtocol() entirely.
+
+    Entries are addressed by a hash of the first/a stream and the carrier,
+    which is everything the fingerprint is derived from. Each holds a copy
+    of the stream, so a hash collision can't hand a code somebody else's
+    fingerprint, as well as the fingerprint summary, its histograms, and
+    the index of the protocol it matched in gProtocol[].
+
+    The file starts with fingerprintSignature(), a hash of the protocol
+    table and the tolerances. If that no longer matches, the whole cache is
+    ignored and rebuilt. So is a cache written by a machine with a
+    different byte order or word size, as the records are read back as is.
+    Only the entries used in a run are written back, so codes that have
+    gone from the database drop out of the cache.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "analyse-ir-codes.h"
+#include "analyse.h"
+#include "cache.h"
+
+#define CACHE_MAGIC         "IRFC"
+#define CACHE_VERSION       2
+#define CACHE_ORDER         0x01020304
+#define CACHE_NO_PROTOCOL   (-1)
+#define CACHE_INITIAL_SIZE  1024    /* must be a power of two */
+
+typedef struct {
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    byteOrder;      /* CACHE_ORDER, as written by this machine */
+    uint32_t    wordSize;       /* sizeof(unsigned long) */
+    uint64_t    signature;
+    uint64_t    entryCount;
+} tCacheHeader;
+
+/* followed by streamCount periods, as uint64_t's, then markCount and spaceCount tCacheHistEntry's */
+typedef struct {
+    uint64_t    key;
+    uint64_t    carrierFreq;
+    uint64_t    streamCount;
+    int32_t     protocol;       /* index into gProtocol[], or CACHE_NO_PROTOCOL */
+    uint32_t    encoding;
+    uint32_t    symbolCount;
+    uint32_t    markCount;      /* zero if there's no histogram */
+    uint32_t    spaceCount;
+    uint32_t    unused;
+    uint64_t    duration;
+    uint64_t    leading[2];
+    uint64_t    trailing[2];
+} tCacheRecord;
+
+typedef struct {
+    uint64_t    period;
+    uint64_t    count;
+} tCacheHistEntry;
+
+typedef struct {
+    uint64_t        key;            /* zero if the slot is empty */
+    unsigned long   carrierFreq;
+    tIRStream       *stream;        /* a copy of the first/a stream, from the cache's arena */
+    int             used;           /* looked up or added this run - worth saving */
+    tFingerprint    fingerprint;
+} tCacheEntry;
+
+static struct {
+    tCacheEntry *table;
+    size_t      size;               /* always a power of two */
+    size_t      count;
+    tArena      arena;              /* streams and histograms - must outlive gArena resets when streaming */
+    unsigned long hits, misses;
+    pthread_mutex_t lock;           /* analysis may be running on several threads */
+} gCache = { NULL, 0, 0, ARENA_INITIALIZER, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+
+static uint64_t streamKey( tIRStream *stream, unsigned long carrierFreq )
+{
+    uint64_t    hash = WORD_HASH_SEED;
+    tCount      i;
+
+    hash = WORD_HASH_STEP( hash, carrierFreq );
+    hash = WORD_HASH_STEP( hash, stream->count );
+    for (i = 0; i < stream->count; ++i)
+        hash = WORD_HASH_STEP( hash, stream->period[i] );
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+
+    /* zero marks an empty slot */
+    return (hash != 0) ? hash : 1;
+}
+
+static int sameStream( tIRStream *a, tIRStream *b )
+{
+    return ( a->count == b->count
+          && memcmp( a->period, b->period, a->count * sizeof(unsigned long) ) == 0 );
+}
+
+/* the slot holding this stream, or the empty one it would go in. Equal keys alone aren't enough */
+static tCacheEntry *findSlot( uint64_t key, unsigned long carrierFreq, tIRStream *stream )
+{
+    tCacheEntry *entry;
+    size_t      i;
+
+    for (i = key & (gCache.size - 1); ; i = (i + 1) & (gCache.size - 1))
+    {
+        entry = &gCache.table[i];
+        if ( entry->key == 0
+          || (entry->key == key && entry->carrierFreq == carrierFreq && sameStream( entry->stream, stream )) )
+            return entry;
+    }
+}
+
+/* keeps the table at most half full */
+static int growCache( void )
+{
+    tCacheEntry *old = gCache.table, *entry;
+    size_t      oldSize = gCache.size, i;
+
+    if ( (gCache.count + 1) * 2 <= gCache.size )
+        return 1;
+
+    gCache.size  = (oldSize != 0) ? oldSize * 2 : CACHE_INITIAL_SIZE;
+    gCache.table = calloc( gCache.size, sizeof(tCacheEntry) );
+    if (gCache.table == NULL)
+    {
+        logErrorErrno("unable to grow the fingerprint cache");
+        gCache.table = old;
+        gCache.size  = oldSize;
+        return 0;
+    }
+
+    for (i = 0; i < oldSize; ++i)
+    {
+        if (old[i].key != 0)
+        {
+            entry  = findSlot( old[i].key, old[i].carrierFreq, old[i].stream );
+            *entry = old[i];
+        }
+    }
+    free(old);
+
+    return 1;
+}
+
+static tHistogram *copyHistogram( tHistogram *hist )
+{
+    tHistogram  *result;
+
+    if (hist == NULL)
+        return NULL;
+
+    result = arenaAlloc( &gCache.arena, sizeof(tHistogram) + hist->count * sizeof(tHistEntry) );
+    if (result != NULL)
+        memcpy( result, hist, sizeof(tHistogram) + hist->count * sizeof(tHistEntry) );
+
+    return result;
+}
+
+static tIRStream *copyStream( tIRStream *stream )
+{
+    tIRStream   *result;
+    size_t      size = sizeof(tIRStream) + stream->count * sizeof(unsigned long);
+
+    result = arenaAlloc( &gCache.arena, size );
+    if (result != NULL)
+        memcpy( result, stream, size );
+
+    return result;
+}
+
+static int protocolIndex( tReferenceFingerprint *protocol )
+{
+    return (protocol != NULL) ? (int)(protocol - gProtocol) : CACHE_NO_PROTOCOL;
+}
+
+int lookupFingerprint( tIRStream *stream, tFingerprint *fingerprint )
+{
+    tCacheEntry *entry;
+
+    if (gCache.table == NULL)
+        return 0;
+
+    pthread_mutex_lock( &gCache.lock );
+    entry = findSlot( streamKey( stream, fingerprint->carrierFreq ), fingerprint->carrierFreq, stream );
+    if (entry->key == 0)
+    {
+        ++gCache.misses;
+        pthread_mutex_unlock( &gCache.lock );
+        return 0;
+    }
+    ++gCache.hits;
+    entry->used = 1;
+
+    fingerprint->encoding       = entry->fingerprint.encoding;
+    fingerprint->symbolCount    = entry->fingerprint.symbolCount;
+    fingerprint->leading        = entry->fingerprint.leading;
+    fingerprint->trailing       = entry->fingerprint.trailing;
+    fingerprint->duration       = entry->fingerprint.duration;
+    fingerprint->mark           = entry->fingerprint.mark;
+    fingerprint->space          = entry->fingerprint.space;
+    fingerprint->protocol       = entry->fingerprint.protocol;
+
+    pthread_mutex_unlock( &gCache.lock );
+
+    return 1;
+}
+
+void storeFingerprint( tIRStream *stream, tFingerprint *fingerprint )
+{
+    tCacheEntry *entry;
+    uint64_t    key;
+
+    if (gCache.table == NULL)
+        return;
+
+    pthread_mutex_lock( &gCache.lock );
+    if ( !growCache() )
+    {
+        pthread_mutex_unlock( &gCache.lock );
+        return;
+    }
+
+    key   = streamKey( stream, fingerprint->carrierFreq );
+    entry = findSlot( key, fingerprint->carrierFreq, stream );
+    if (entry->key == 0)
+    {
+        entry->stream = copyStream( stream );
+        if (entry->stream == NULL)
+        {
+            pthread_mutex_unlock( &gCache.lock );
+            return;
+        }
+        ++gCache.count;
+    }
+
+    entry->key          = key;
+    entry->carrierFreq  = fingerprint->carrierFreq;
+    entry->used         = 1;
+    entry->fingerprint  = *fingerprint;
+    entry->fingerprint.mark  = copyHistogram( fingerprint->mark );
+    entry->fingerprint.space = copyHistogram( fingerprint->space );
+    pthread_mutex_unlock( &gCache.lock );
+}
+
+static tIRStream *readStream( FILE *file, uint64_t count )
+{
+    tIRStream   *stream;
+    uint64_t    period;
+    uint64_t    i;
+
+    if (count == 0 || count > (SIZE_MAX - sizeof(tIRStream)) / sizeof(unsigned long))
+        return NULL;
+
+    stream = arenaAlloc( &gCache.arena, sizeof(tIRStream) + count * sizeof(unsigned long) );
+    if (stream == NULL)
+        return NULL;
+
+    stream->count = count;
+    for (i = 0; i < count; ++i)
+    {
+        if ( fread( &period, sizeof(period), 1, file ) != 1 )
+            return NULL;
+        stream->period[i] = period;
+    }
+    return stream;
+}
+
+static tHistogram *readHistogram( FILE *file, uint32_t count )
+{
+    tHistogram      *hist;
+    tCacheHistEntry entry;
+    uint32_t        i;
+
+    if (count == 0 || count > MAX_HIST_SIZE)
+        return NULL;
+
+    hist = arenaAlloc( &gCache.arena, sizeof(tHistogram) + count * sizeof(tHistEntry) );
+    if (hist == NULL)
+        return NULL;
+
+    hist->count = count;
+    for (i = 0; i < count; ++i)
+    {
+        if ( fread( &entry, sizeof(entry), 1, file ) != 1 )
+            return NULL;
+        hist->d[i].period = entry.period;
+        hist->d[i].count  = entry.count;
+    }
+    return hist;
+}
+
+/*
+    A missing or stale cache isn't an error - it just starts out empty.
+    Returns -3 if the file exists but can't be read.
+*/
+int loadFingerprintCache( const char *filename )
+{
+    FILE            *file;
+    tCacheHeader    header;
+    tCacheRecord    record;
+    tCacheEntry     *entry;
+    tIRStream       *stream;
+    int             protocolCount;
+    uint64_t        i;
+
+    if (gCache.table == NULL && !growCache())
+        return (-4);
+
+    file = fopen( filename, "rb" );
+    if (file == NULL)
+    {
+        if (errno != ENOENT)
+        {
+            logErrorErrno("unable to open fingerprint cache \"%s\"", filename);
+            return (-3);
+        }
+        logInfo("no fingerprint cache yet, creating \"%s\"", filename);
+        return (0);
+    }
+
+    for (protocolCount = 0; gProtocol[protocolCount].confidence != kListEnd; ++protocolCount)
+        { }
+
+    if ( fread( &header, sizeof(header), 1, file ) != 1
+      || memcmp( header.magic, CACHE_MAGIC, sizeof(header.magic) ) != 0
+      || header.version != CACHE_VERSION )
+    {
+        logWarning("\"%s\" is not a fingerprint cache, ignoring it", filename);
+        fclose(file);
+        return (0);
+    }
+    if ( header.byteOrder != CACHE_ORDER || header.wordSize != sizeof(unsigned long) )
+    {
+        logWarning("fingerprint cache \"%s\" was written by a different kind of machine, ignoring it", filename);
+        fclose(file);
+        return (0);
+    }
+    if ( header.signature != fingerprintSignature() )
+    {
+        logInfo("protocols or tolerances have changed, discarding the fingerprint cache");
+        fclose(file);
+        return (0);
+    }
+
+    for (i = 0; i < header.entryCount; ++i)
+    {
+        if ( fread( &record, sizeof(record), 1, file ) != 1
+          || record.key == 0
+          || record.protocol < CACHE_NO_PROTOCOL || record.protocol >= protocolCount
+          || record.markCount > MAX_HIST_SIZE || record.spaceCount > MAX_HIST_SIZE
+          || !growCache() )
+            break;
+
+        stream = readStream( file, record.streamCount );
+        if (stream == NULL)
+            break;
+
+        entry = findSlot( record.key, record.carrierFreq, stream );
+        if (entry->key == 0)
+            ++gCache.count;
+
+        entry->key          = record.key;
+        entry->carrierFreq  = record.carrierFreq;
+        entry->stream       = stream;
+        entry->used         = 0;
+        entry->fingerprint.encoding     = record.encoding;
+        entry->fingerprint.symbolCount  = record.symbolCount;
+        entry->fingerprint.duration     = record.duration;
+        entry->fingerprint.leading.mark   = record.leading[0];
+        entry->fingerprint.leading.space  = record.leading[1];
+        entry->fingerprint.trailing.mark  = record.trailing[0];
+        entry->fingerprint.trailing.space = record.trailing[1];
+        entry->fingerprint.protocol = (record.protocol != CACHE_NO_PROTOCOL) ? &gProtocol[record.protocol] : NULL;
+        entry->fingerprint.mark     = readHistogram( file, record.markCount );
+        entry->fingerprint.space    = readHistogram( file, record.spaceCount );
+
+        if ( (record.markCount  != 0 && entry->fingerprint.mark  == NULL)
+          || (record.spaceCount != 0 && entry->fingerprint.space == NULL) )
+        {
+            entry->key = 0;
+            --gCache.count;
+            break;
+        }
+    }
+
+    if (i < header.entryCount)
+    {
+        /* what's been read so far is still good - a broken entry can't be skipped */
+        logWarning("fingerprint cache \"%s\" is truncated or corrupt after %lu entries",
+                    filename, (unsigned long)i);
+    }
+    fclose(file);
+
+    logDebug(1, "loaded %lu fingerprints from \"%s\"", (unsigned long)gCache.count, filename);
+    return (0);
+}
+
+static void writeStream( FILE *file, tIRStream *stream )
+{
+    uint64_t    period;
+    tCount      i;
+
+    for (i = 0; i < stream->count; ++i)
+    {
+        period = stream->period[i];
+        fwrite( &period, sizeof(period), 1, file );
+    }
+}
+
+static void writeHistogram( FILE *file, tHistogram *hist )
+{
+    tCacheHistEntry entry;
+    tCount          i;
+
+    for (i = 0; hist != NULL && i < hist->count; ++i)
+    {
+        entry.period = hist->d[i].period;
+        entry.count  = hist->d[i].count;
+        fwrite( &entry, sizeof(entry), 1, file );
+    }
+}
+
+/* written to a temporary file first, so an interrupted run can't leave a broken cache */
+int saveFingerprintCache( const char *filename )
+{
+    FILE            *file;
+    char            *tempName;
+    tCacheHeader    header;
+    tCacheRecord    record;
+    tCacheEntry     *entry;
+    size_t          i;
+    int             result = 0;
+
+    logDebug(1, "fingerprint cache: %lu hits, %lu misses", gCache.hits, gCache.misses);
+
+    if (gCache.table == NULL)
+        return (0);
+
+    tempName = malloc( strlen(filename) + sizeof(".tmp") );
+    if (tempName == NULL)
+        return (-4);
+    sprintf( tempName, "%s.tmp", filename );
+
+    file = fopen( tempName, "wb" );
+    if (file == NULL)
+    {
+        logErrorErrno("unable to write fingerprint cache \"%s\"", tempName);
+        free(tempName);
+        return (-3);
+    }
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, CACHE_MAGIC, sizeof(header.magic) );
+    header.version   = CACHE_VERSION;
+    header.byteOrder = CACHE_ORDER;
+    header.wordSize  = sizeof(unsigned long);
+    header.signature = fingerprintSignature();
+    for (i = 0; i < gCache.size; ++i)
+        header.entryCount += (gCache.table[i].key != 0 && gCache.table[i].used);
+
+    fwrite( &header, sizeof(header), 1, file );
+
+    for (i = 0; i < gCache.size; ++i)
+    {
+        entry = &gCache.table[i];
+        if (entry->key == 0 || !entry->used)
+            continue;
+
+        memset( &record, 0, sizeof(record) );
+        record.key          = entry->key;
+        record.carrierFreq  = entry->carrierFreq;
+        record.streamCount  = entry->stream->count;
+        record.protocol     = protocolIndex( entry->fingerprint.protocol );
+        record.encoding     = entry->fingerprint.encoding;
+        record.symbolCount  = entry->fingerprint.symbolCount;
+        record.markCount    = (entry->fingerprint.mark  != NULL) ? entry->fingerprint.mark->count  : 0;
+        record.spaceCount   = (entry->fingerprint.space != NULL) ? entry->fingerprint.space->count : 0;
+        record.duration     = entry->fingerprint.duration;
+        record.leading[0]   = entry->fingerprint.leading.mark;
+        record.leading[1]   = entry->fingerprint.leading.space;
+        record.trailing[0]  = entry->fingerprint.trailing.mark;
+        record.trailing[1]  = entry->fingerprint.trailing.space;
+
+        fwrite( &record, sizeof(record), 1, file );
+        writeStream( file, entry->stream );
+        writeHistogram( file, entry->fingerprint.mark );
+        writeHistogram( file, entry->fingerprint.space );
+        if (ferror(file)) break;
+    }
+
+    if ( fflush(file) != 0 || ferror(file) )
+    {
+        logErrorErrno("error writing fingerprint cache \"%s\"", tempName);
+        result = -3;
+    }
+    fclose(file);
+
+    if (result == 0 && rename( tempName, filename ) != 0)
+    {
+        logErrorErrno("unable to replace fingerprint cache \"%s\"", filename);
+        result = -3;
+    }
+    if (result != 0)
+        remove(tempName);
+
+    free(tempName);
+    free(gCache.table);
+    gCache.table = NULL;
+    gCache.size  = 0;
+    gCache.count = 0;
+    arenaRelease( &gCache.arena );
+
+    return result;
+}
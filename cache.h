@@ -0,0 +1,21 @@
+/*
+    @file cache.h
+
+    Persistent cache of fingerprints, keyed by the content of each code's
+    first/a stream and its carrier.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include <stdint.h>
+
+/* defined in analyse.c - a hash of the protocol table and tolerances */
+uint64_t fingerprintSignature(void);
+
+/* both return zero if the cache file can be used (or didn't exist yet) */
+int loadFingerprintCache(const char *filename);
+int saveFingerprintCache(const char *filename);
+
+/* fills in the fingerprint and returns 1 on a hit. A no-op until the cache is loaded */
+int lookupFingerprint(tIRStream *stream, tFingerprint *fingerprint);
+void storeFingerprint(tIRStream *stream, tFingerprint *fingerprint);
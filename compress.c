@@ -0,0 +1,390 @@
+/*
+    @file compress.c
+
+    Transparent gzip (de)compression of the input and output files.
+
+    Compressed input is inflated on a thread of its own and handed to the
+    importer through a pipe. The pipe is the bounded buffer between them -
+    the importer parses one chunk while the next is being inflated.
+
+    Compressed output runs the other way: the exporter writes into a pipe,
+    and a collector thread cuts what comes out of it into blocks, deflating
+    each block on its own thread as a separate gzip member. The members are
+    written out in order, and back to back they're still one gzip file.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include <pthread.h>
+#include <zlib.h>
+
+#include "compress.h"
+
+#define GZIP_MAGIC          0x1F    /* first byte of a gzip member */
+#define ZSTD_MAGIC          0x28    /* first byte of a zstd frame */
+
+#define INFLATE_CHUNK       (64 * 1024)
+#define DEFLATE_BLOCK       (1024 * 1024)
+#define MAX_DEFLATE_THREADS 64
+
+static struct {
+    FILE        *compressed;    /* the file named on the command line */
+    FILE        *pipe;          /* the end the importer reads from */
+    int         fd;             /* the end the inflate thread writes to */
+    pthread_t   thread;
+    int         error;
+} gInflater;
+
+typedef struct {
+    pthread_t       thread;
+    unsigned char   *in;
+    size_t          inLength;
+    unsigned char   *out;
+    size_t          outLength;
+    size_t          outSize;
+    int             error;
+} tDeflateBlock;
+
+static struct {
+    FILE        *compressed;    /* the file named on the command line */
+    FILE        *pipe;          /* the end the exporter writes to */
+    int         fd;             /* the end the collector reads from */
+    int         threadCount;
+    pthread_t   thread;
+    int         error;
+} gDeflater;
+
+static int writeAll( int fd, const unsigned char *buffer, size_t length )
+{
+    ssize_t written;
+
+    while (length > 0)
+    {
+        written = write( fd, buffer, length );
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return 0;
+        }
+        buffer += written;
+        length -= written;
+    }
+    return 1;
+}
+
+/* keeps reading until the buffer is full, or the writer goes away */
+static size_t readAll( int fd, unsigned char *buffer, size_t length )
+{
+    size_t  total = 0;
+    ssize_t got;
+
+    while (total < length)
+    {
+        got = read( fd, buffer + total, length - total );
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        total += got;
+    }
+    return total;
+}
+
+static void *inflateThread( void *UNUSED(arg) )
+{
+    static unsigned char in[INFLATE_CHUNK], out[INFLATE_CHUNK];
+    z_stream    z;
+    int         result = Z_OK;
+
+    memset( &z, 0, sizeof(z) );
+    if ( inflateInit2( &z, 16 + MAX_WBITS ) != Z_OK )
+    {
+        logError("unable to initialize zlib");
+        gInflater.error = -4;
+        close( gInflater.fd );
+        return NULL;
+    }
+
+    for (;;)
+    {
+        if (z.avail_in == 0)
+        {
+            z.next_in  = in;
+            z.avail_in = fread( in, 1, sizeof(in), gInflater.compressed );
+            if (z.avail_in == 0)
+                break;
+        }
+
+        /* there may be more than one member - pigz, and our own output, make them */
+        if (result == Z_STREAM_END)
+            inflateReset( &z );
+
+        z.next_out  = out;
+        z.avail_out = sizeof(out);
+        result = inflate( &z, Z_NO_FLUSH );
+        if (result != Z_OK && result != Z_STREAM_END)
+            break;
+
+        if ( !writeAll( gInflater.fd, out, sizeof(out) - z.avail_out ) )
+        {
+            logErrorErrno("unable to pass on decompressed input");
+            gInflater.error = -3;
+            break;
+        }
+    }
+
+    if (ferror(gInflater.compressed))
+    {
+        logErrorErrno("error reading compressed input");
+        gInflater.error = -3;
+    }
+    else if (gInflater.error == 0 && result != Z_STREAM_END)
+    {
+        logError("compressed input is %s", (result == Z_OK) ? "truncated" : "corrupt");
+        gInflater.error = -3;
+    }
+
+    inflateEnd( &z );
+    close( gInflater.fd );  /* the importer sees end of file */
+
+    return NULL;
+}
+
+/*
+    Looks at the first byte of the input. Text starts with a code set ID and
+    binary with its magic number, so neither can be mistaken for gzip.
+*/
+FILE *openDecompressor( FILE *file )
+{
+    int     c, fds[2];
+
+    c = getc(file);
+    ungetc(c, file);
+
+    switch (c)
+    {
+    case GZIP_MAGIC:
+        break;
+
+    case ZSTD_MAGIC:
+        fatalExit(-3, "zstd compressed input isn't supported - decompress it first");
+
+    default:
+        return file;
+    }
+
+    logDebug(1, "input is gzip compressed");
+
+    if ( pipe(fds) != 0 )
+        fatalExitErrno(-3, "unable to create a pipe for decompression");
+
+    gInflater.compressed = file;
+    gInflater.fd    = fds[1];
+    gInflater.error = 0;
+    gInflater.pipe  = fdopen( fds[0], "r" );
+    if (gInflater.pipe == NULL)
+        fatalExitErrno(-3, "unable to open the decompression pipe");
+
+    if ( pthread_create( &gInflater.thread, NULL, inflateThread, NULL ) != 0 )
+        fatalExit(-4, "unable to start the decompression thread");
+
+    return gInflater.pipe;
+}
+
+/* returns zero, or the first error the inflate thread ran into */
+int closeDecompressor( FILE *file )
+{
+    char    buffer[4096];
+
+    if (file == NULL || file != gInflater.pipe)
+        return (0);
+
+    /* drain whatever the importer didn't want, so the thread can't block on the pipe */
+    while ( fread( buffer, 1, sizeof(buffer), file ) > 0 )
+        { }
+
+    fclose( file );
+    pthread_join( gInflater.thread, NULL );
+    gInflater.pipe = NULL;
+
+    return gInflater.error;
+}
+
+static void *deflateThread( void *arg )
+{
+    tDeflateBlock   *block = arg;
+    z_stream        z;
+    size_t          bound;
+
+    memset( &z, 0, sizeof(z) );
+    if ( deflateInit2( &z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+    {
+        block->error = -4;
+        return NULL;
+    }
+
+    bound = deflateBound( &z, block->inLength );
+    if (bound > block->outSize)
+    {
+        free( block->out );
+        block->out = malloc( bound );
+        block->outSize = (block->out != NULL) ? bound : 0;
+    }
+
+    block->error = -4;
+    if (block->out != NULL)
+    {
+        z.next_in   = block->in;
+        z.avail_in  = block->inLength;
+        z.next_out  = block->out;
+        z.avail_out = block->outSize;
+        if ( deflate( &z, Z_FINISH ) == Z_STREAM_END )
+        {
+            block->outLength = block->outSize - z.avail_out;
+            block->error = 0;
+        }
+    }
+    deflateEnd( &z );
+
+    return NULL;
+}
+
+/* reads up to threadCount blocks from the pipe. A short block means the exporter is done */
+static int fillBlocks( tDeflateBlock *blocks, int first, int *endOfFile )
+{
+    int     count;
+
+    for (count = 0; count < gDeflater.threadCount && !*endOfFile; ++count)
+    {
+        blocks[count].inLength = readAll( gDeflater.fd, blocks[count].in, DEFLATE_BLOCK );
+        if (blocks[count].inLength < DEFLATE_BLOCK)
+        {
+            *endOfFile = 1;
+            /* an empty block is only worth keeping if it's the whole file */
+            if (blocks[count].inLength == 0 && (count > 0 || !first))
+                break;
+        }
+    }
+    return count;
+}
+
+/*
+    Double buffered - while one set of blocks is being deflated, the next
+    set is read from the pipe, so the exporter keeps going.
+*/
+static void *collectorThread( void *UNUSED(arg) )
+{
+    tDeflateBlock   *blocks[2], *block;
+    int             count[2], current, endOfFile, i;
+
+    for (i = 0; i < 2; ++i)
+    {
+        blocks[i] = calloc( gDeflater.threadCount, sizeof(tDeflateBlock) );
+        if (blocks[i] == NULL)
+            fatalExit(-4, "unable to allocate compression buffers");
+    }
+    for (i = 0; i < 2 * gDeflater.threadCount; ++i)
+    {
+        block = &blocks[i & 1][i >> 1];
+        block->in = malloc( DEFLATE_BLOCK );
+        if (block->in == NULL)
+            fatalExit(-4, "unable to allocate compression buffers");
+    }
+
+    endOfFile = 0;
+    current = 0;
+    count[current] = fillBlocks( blocks[current], 1, &endOfFile );
+    while (count[current] > 0)
+    {
+        for (i = 0; i < count[current]; ++i)
+        {
+            if ( pthread_create( &blocks[current][i].thread, NULL, deflateThread, &blocks[current][i] ) != 0 )
+                fatalExit(-4, "unable to start a compression thread");
+        }
+
+        count[!current] = fillBlocks( blocks[!current], 0, &endOfFile );
+
+        for (i = 0; i < count[current]; ++i)
+        {
+            block = &blocks[current][i];
+            pthread_join( block->thread, NULL );
+
+            /* on an error, keep draining the pipe so the exporter can finish */
+            if (gDeflater.error != 0)
+                continue;
+
+            if (block->error != 0)
+            {
+                logError("unable to compress the output");
+                gDeflater.error = block->error;
+            }
+            else if ( fwrite( block->out, 1, block->outLength, gDeflater.compressed ) != block->outLength )
+            {
+                logErrorErrno("error writing compressed output");
+                gDeflater.error = -3;
+            }
+        }
+        current = !current;
+    }
+
+    for (i = 0; i < 2 * gDeflater.threadCount; ++i)
+    {
+        block = &blocks[i & 1][i >> 1];
+        free( block->in );
+        free( block->out );
+    }
+    free( blocks[0] );
+    free( blocks[1] );
+    close( gDeflater.fd );
+
+    return NULL;
+}
+
+FILE *openCompressor( FILE *file, int threadCount )
+{
+    int     fds[2];
+
+    if (threadCount < 1)
+        threadCount = 1;
+    if (threadCount > MAX_DEFLATE_THREADS)
+        threadCount = MAX_DEFLATE_THREADS;
+
+    logDebug(1, "compressing output on %d thread(s)", threadCount);
+
+    if ( pipe(fds) != 0 )
+        fatalExitErrno(-3, "unable to create a pipe for compression");
+
+    gDeflater.compressed  = file;
+    gDeflater.fd          = fds[0];
+    gDeflater.threadCount = threadCount;
+    gDeflater.error       = 0;
+    gDeflater.pipe = fdopen( fds[1], "w" );
+    if (gDeflater.pipe == NULL)
+        fatalExitErrno(-3, "unable to open the compression pipe");
+
+    if ( pthread_create( &gDeflater.thread, NULL, collectorThread, NULL ) != 0 )
+        fatalExit(-4, "unable to start the compression thread");
+
+    return gDeflater.pipe;
+}
+
+/* returns zero, or the first error hit compressing or writing the output */
+int closeCompressor( FILE *file )
+{
+    if (file == NULL || file != gDeflater.pipe)
+        return (0);
+
+    fclose( file );     /* the collector sees end of file */
+    pthread_join( gDeflater.thread, NULL );
+    gDeflater.pipe = NULL;
+
+    if ( fflush( gDeflater.compressed ) != 0 && gDeflater.error == 0 )
+    {
+        logErrorErrno("error writing compressed output");
+        gDeflater.error = -3;
+    }
+    return gDeflater.error;
+}
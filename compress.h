@@ -0,0 +1,15 @@
+/*
+    @file compress.h
+
+    gzip compressed input and output, (de)compressed on threads of their
+    own. Both hand back a FILE to use in place of the one passed in.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+/* returns file itself if it isn't compressed */
+FILE *openDecompressor(FILE *file);
+int closeDecompressor(FILE *file);
+
+FILE *openCompressor(FILE *file, int threadCount);
+int closeCompressor(FILE *file);
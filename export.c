@@ -7,100 +7,440 @@
 #include "common.h"
 
 #include <sys/param.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #include "analyse-ir-codes.h"
 #include "export.h"
+#include "binarydb.h"
+#include "firmware.h"
+#include "stats.h"
 
-int exportIRStream( FILE *file, const char prefix, tIRStream *stream)
+/* formatted text is collected here, and written out a block at a time */
+#define EXPORT_BUFFER_SIZE  (1024 * 1024)
+#define EXPORT_MAX_NUMBER   24      /* room for a separator and any unsigned long */
+#define MAX_EXPORT_THREADS  64
+
+typedef struct {
+    FILE    *file;                  /* written to in order, or... */
+    int     fd;                     /* ...if not -1, written to at offset with pwrite() */
+    off_t   start, offset;
+    char    *end;                   /* of what's been formatted so far */
+    int     error;
+    char    data[EXPORT_BUFFER_SIZE];
+} tExportBuffer;
+
+/* one per export thread - each formats a run of code sets, and writes it where it belongs */
+typedef struct {
+    pthread_t       thread;
+    size_t          firstSet, endSet;
+    off_t           length;
+    tExportBuffer   *buffer;
+} tExporter;
+
+static const char gDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char *repeatString(tRepeatType repeatType)
+{
+    switch (repeatType)
+    {
+    case kFullRepeat:     return "|Full_Repeat|";
+    case kPartialRepeat:  return "|Partial_Repeat|";
+    case kRepeat:         return "|Repeat|";
+    case kToggleRepeat:   return "|Toggle|";
+    default:              return "|Unknown|";
+    }
+}
+
+static int writeAt( int fd, const char *data, size_t length, off_t offset )
 {
-    tCount  i, count;
-    char sep = prefix;
-    
-    if (stream != NULL)
+    ssize_t written;
+
+    while (length > 0)
     {
-        count = stream->count;
-        i = 0;
-        while ( i < count )
+        written = pwrite( fd, data, length, offset );
+        if (written < 0)
         {
-            fprintf(file, "%c%lu", sep, stream->period[i++]);
-            if (ferror(file)) return 0;
-            sep = ',';
+            if (errno == EINTR)
+                continue;
+            return 0;
         }
+        data   += written;
+        length -= written;
+        offset += written;
     }
     return 1;
 }
 
-int exportDB( FILE * file )
+/* writes out what has been formatted - the only place errors are checked */
+static void flushExport(tExportBuffer *buffer)
 {
-    const char  *repeatStr;
+    size_t  length = buffer->end - buffer->data;
 
-    tIRCodeSet  *codeSet;
-    tIRCode     *code;
+    if ( !buffer->error && length > 0 )
+    {
+        if (buffer->fd != -1)
+            buffer->error = !writeAt( buffer->fd, buffer->data, length, buffer->offset );
+        else if ( fwrite(buffer->data, 1, length, buffer->file) != length || ferror(buffer->file) )
+            buffer->error = 1;
+    }
+    buffer->offset += length;
+    buffer->end = buffer->data;
+}
+
+static tExportBuffer *newExportBuffer(FILE *file, int fd, off_t offset)
+{
+    tExportBuffer *buffer;
+
+    buffer = malloc( sizeof(tExportBuffer) );
+    if (buffer == NULL)
+        fatalExit(-4, "unable to allocate an output buffer");
 
-    codeSet = gIRCodeSets;
-    if (codeSet != NULL)
-        code = codeSet->irCodes;
+    buffer->file   = file;
+    buffer->fd     = fd;
+    buffer->start  = offset;
+    buffer->offset = offset;
+    buffer->end    = buffer->data;
+    buffer->error  = 0;
+    return buffer;
+}
+
+/* flushes and frees the buffer, returning zero or -3 if there was an error writing it */
+static int finishExport(tExportBuffer *buffer)
+{
+    int     error;
 
-    while ( codeSet != NULL )
+    flushExport(buffer);
+    error = buffer->error;
+    if (!error)
+        countBytesWritten( buffer->offset - buffer->start );
+    free(buffer);
+
+    if (error)
     {
-        /* dump this IR code */
-        switch (code->fingerprint.repeatType)
+        logDebugErrno(0, "error writing to output");
+        return (-3);
+    }
+    return (0);
+}
+
+/* makes sure there's room for 'length' more bytes */
+static inline void reserveExport(tExportBuffer *buffer, size_t length)
+{
+    if ((size_t)(buffer->data + EXPORT_BUFFER_SIZE - buffer->end) < length)
+        flushExport(buffer);
+}
+
+static void exportBytes(tExportBuffer *buffer, const char *bytes, size_t length)
+{
+    if (length > EXPORT_BUFFER_SIZE / 2)
+    {
+        /* not worth copying */
+        flushExport(buffer);
+        if ( !buffer->error )
         {
-        case kFullRepeat:     repeatStr = "Full_Repeat";    break;
-        case kPartialRepeat:  repeatStr = "Partial_Repeat"; break;
-        case kRepeat:         repeatStr = "Repeat";         break;
-        case kToggleRepeat:   repeatStr = "Toggle";         break;
-        default:              repeatStr = "Unknown";        break;
+            if (buffer->fd != -1)
+                buffer->error = !writeAt( buffer->fd, bytes, length, buffer->offset );
+            else if ( fwrite(bytes, 1, length, buffer->file) != length )
+                buffer->error = 1;
         }
+        buffer->offset += length;
+        return;
+    }
+    reserveExport(buffer, length);
+    memcpy(buffer->end, bytes, length);
+    buffer->end += length;
+}
 
-        fprintf( file, "%u|%lu|%s|%s",
-                codeSet->id,
-                code->fingerprint.carrierFreq,
-                repeatStr,
-                code->button.label);
-        if (ferror(file)) break;
+static inline size_t numberLength(unsigned long number)
+{
+    size_t  length = 1;
+
+    while (number >= 100)
+    {
+        length += 2;
+        number /= 100;
+    }
+    return length + (number >= 10);
+}
+
+/* as "%lu" would - two digits at a time. The caller reserves the room */
+static inline void exportNumber(tExportBuffer *buffer, unsigned long number)
+{
+    char    digits[EXPORT_MAX_NUMBER], *d;
+    size_t  length;
+
+    d = digits + sizeof(digits);
+    while (number >= 100)
+    {
+        d -= 2;
+        memcpy(d, &gDigitPairs[(number % 100) * 2], 2);
+        number /= 100;
+    }
+    if (number >= 10)
+    {
+        d -= 2;
+        memcpy(d, &gDigitPairs[number * 2], 2);
+    }
+    else *--d = '0' + number;
+
+    length = digits + sizeof(digits) - d;
+    memcpy(buffer->end, d, length);
+    buffer->end += length;
+}
 
+static void exportIRStream( tExportBuffer *buffer, const char prefix, tIRStream *stream )
+{
+    tCount  i;
+    char    sep = prefix;
+
+    for (i = 0; i < stream->count; ++i)
+    {
+        reserveExport(buffer, EXPORT_MAX_NUMBER);
+        *buffer->end++ = sep;
+        exportNumber(buffer, stream->period[i]);
+        sep = ',';
+    }
+}
+
+static void exportCodeSet( tExportBuffer *buffer, tIRCodeSet *codeSet )
+{
+    const char  *repeatStr;
+    tIRCode     *code;
+    tIRCodeLabel *label;
+    size_t      i;
+
+    for (i = codeSet->firstCode; i < codeSet->firstCode + codeSet->codeCount && !buffer->error; ++i)
+    {
+        code  = &gStore.codes[i];
+        label = &gStore.labels[i];
+
+        /* dump this IR code */
+        repeatStr = repeatString(code->fingerprint.repeatType);
+
+        reserveExport(buffer, 2 * EXPORT_MAX_NUMBER);
+        exportNumber(buffer, codeSet->id);
+        *buffer->end++ = '|';
+        exportNumber(buffer, code->fingerprint.carrierFreq);
+        exportBytes(buffer, repeatStr, strlen(repeatStr));
+        exportBytes(buffer, label->label, label->labelLength);
+
+        reserveExport(buffer, 1);
         if (code->first.a != NULL)
-        {
-            if ( !exportIRStream( file, '|', code->first.a ) ) break;
-        }
-        else putc('|', file);
+            exportIRStream( buffer, '|', code->first.a );
+        else *buffer->end++ = '|';
 
         if (code->first.b != NULL)
-        {
-            if ( !exportIRStream( file, '^', code->first.b ) ) break;
-        }
+            exportIRStream( buffer, '^', code->first.b );
         
+        reserveExport(buffer, 1);
         if (code->repeat.a != NULL)
-        {
-            if ( !exportIRStream( file, '|', code->repeat.a ) ) break;
-        }
-        else putc('|', file);
+            exportIRStream( buffer, '|', code->repeat.a );
+        else *buffer->end++ = '|';
 
         if (code->repeat.b != NULL)
-        {
-            if ( !exportIRStream( file, '^', code->repeat.b ) ) break;
-        }
+            exportIRStream( buffer, '^', code->repeat.b );
+
+        exportBytes(buffer, "|\r\n", 3);
+    } 
+}
+
+static off_t streamLength( tIRStream *stream )
+{
+    off_t   length;
+    tCount  i;
+
+    if (stream == NULL)
+        return 0;
+
+    length = stream->count;     /* a separator before each period */
+    for (i = 0; i < stream->count; ++i)
+        length += numberLength(stream->period[i]);
+
+    return length;
+}
+
+/* exactly how many bytes exportCodeSet() will produce */
+static off_t codeSetLength( tIRCodeSet *codeSet )
+{
+    tIRCode     *code;
+    off_t       length = 0;
+    size_t      i;
+
+    for (i = codeSet->firstCode; i < codeSet->firstCode + codeSet->codeCount; ++i)
+    {
+        code = &gStore.codes[i];
+
+        length += numberLength(codeSet->id) + 1
+                + numberLength(code->fingerprint.carrierFreq)
+                + strlen(repeatString(code->fingerprint.repeatType))
+                + gStore.labels[i].labelLength
+                + ((code->first.a  != NULL) ? streamLength(code->first.a)  : 1)
+                + streamLength(code->first.b)
+                + ((code->repeat.a != NULL) ? streamLength(code->repeat.a) : 1)
+                + streamLength(code->repeat.b)
+                + 3;
+    }
+    return length;
+}
+
+static void *sizeCodeSets( void *arg )
+{
+    tExporter   *exporter = arg;
+    size_t      i;
+
+    exporter->length = 0;
+    for (i = exporter->firstSet; i < exporter->endSet; ++i)
+        exporter->length += codeSetLength( &gStore.codeSets[i] );
+
+    return NULL;
+}
+
+static void *writeCodeSets( void *arg )
+{
+    tExporter   *exporter = arg;
+    size_t      i;
+
+    for (i = exporter->firstSet; i < exporter->endSet && !exporter->buffer->error; ++i)
+        exportCodeSet( exporter->buffer, &gStore.codeSets[i] );
 
-        fprintf(file, "|\r\n");
+    flushExport( exporter->buffer );
+    return NULL;
+}
+
+/* run fn for every exporter, one thread each. Runs inline if a thread can't be started */
+static void runExporters( tExporter *exporters, int count, void *(*fn)(void *) )
+{
+    int i;
 
-        /* advance to the next IR code */
-        code = code->next;
-        if (code == NULL)
+    for (i = 0; i < count; ++i)
+    {
+        if (i == count - 1 || pthread_create( &exporters[i].thread, NULL, fn, &exporters[i] ) != 0)
         {
-            codeSet = codeSet->next;
-            if (codeSet != NULL)
-                code = codeSet->irCodes;
+            exporters[i].thread = pthread_self();
+            fn( &exporters[i] );
         }
-    } 
+    }
+    for (i = 0; i < count; ++i)
+    {
+        if ( !pthread_equal( exporters[i].thread, pthread_self() ) )
+            pthread_join( exporters[i].thread, NULL );
+    }
+}
 
-    if (ferror(file))
+/*
+    Each thread takes a run of code sets with about the same number of codes
+    in it. The length of every run is worked out first, so each thread knows
+    where its output starts, and can write it there while the others write
+    theirs. Returns 1 if the output was written, 0 if it needs writing in order.
+*/
+static int exportParallel( FILE *file, int threadCount, int *result )
+{
+    struct stat info;
+    tExporter   *exporters;
+    off_t       start, offset;
+    size_t      set, codes;
+    int         fd, w, error;
+
+    fd = fileno(file);
+    if ( fstat( fd, &info ) != 0 || !S_ISREG( info.st_mode ) || (fcntl( fd, F_GETFL ) & O_APPEND) )
+        return 0;
+
+    if (threadCount > MAX_EXPORT_THREADS)
+        threadCount = MAX_EXPORT_THREADS;
+    if ((size_t)threadCount > gStore.codeSetCount)
+        threadCount = gStore.codeSetCount;
+    if (threadCount < 2)
+        return 0;
+
+    if ( fflush(file) != 0 || (start = ftello(file)) < 0 )
+        return 0;
+
+    exporters = calloc( threadCount, sizeof(tExporter) );
+    if (exporters == NULL)
+        fatalExit(-4, "unable to allocate the export threads");
+
+    set = 0;
+    codes = 0;
+    for (w = 0; w < threadCount; ++w)
     {
-        logDebugErrno(0, "error writing to output");
-        return (-3);
+        exporters[w].firstSet = set;
+        while ( set < gStore.codeSetCount
+             && (w == threadCount - 1 || codes < (gStore.codeCount * (w + 1)) / threadCount) )
+            codes += gStore.codeSets[set++].codeCount;
+        exporters[w].endSet = set;
     }
-    return (0);
+
+    runExporters( exporters, threadCount, sizeCodeSets );
+
+    offset = start;
+    for (w = 0; w < threadCount; ++w)
+    {
+        exporters[w].buffer = newExportBuffer( file, fd, offset );
+        offset += exporters[w].length;
+    }
+    logDebug(1, "exporting %lu bytes on %d thread(s)", (unsigned long)(offset - start), threadCount);
+
+    /* set the final size up front, so the threads aren't all extending the file */
+    error = ( ftruncate( fd, offset ) != 0 );
+    if (!error)
+        runExporters( exporters, threadCount, writeCodeSets );
+    else logErrorErrno("unable to set the size of the output");
+
+    for (w = 0; w < threadCount; ++w)
+    {
+        if ( finishExport( exporters[w].buffer ) != 0 )
+            error = 1;
+    }
+    free( exporters );
+
+    if ( fseeko( file, offset, SEEK_SET ) != 0 )
+    {
+        logErrorErrno("unable to seek past the output");
+        error = 1;
+    }
+
+    *result = error ? -3 : 0;
+    return 1;
+}
+
+int exportIRCodeSet( FILE * file, tIRCodeSet *codeSet )
+{
+    tExportBuffer *buffer;
+
+    buffer = newExportBuffer( file, -1, 0 );
+    exportCodeSet( buffer, codeSet );
+    return finishExport( buffer );
 }
 
+/*
+    With more than one thread, and a regular file to write to, the code sets
+    are exported in parallel. Otherwise (a pipe, say) they're written in order.
+*/
+int exportDB( FILE * file, tDBFormat format, int threadCount )
+{
+    tExportBuffer *buffer;
+    size_t      i;
+    int         result;
+
+    if (format == kBinaryFormat)
+        return exportBinaryDB( file );
+
+    if (format == kFirmwareFormat)
+        return exportFirmwareBlob( file );
+
+    if ( exportParallel( file, threadCount, &result ) )
+        return result;
+
+    buffer = newExportBuffer( file, -1, 0 );
+    for (i = 0; i < gStore.codeSetCount && !buffer->error; ++i)
+        exportCodeSet( buffer, &gStore.codeSets[i] );
+
+    return finishExport( buffer );
+}
@@ -4,5 +4,6 @@
     Copyright 2011, Paul Chambers. All Rights Reserved.
 */
 
-int exportDB(FILE *outputFile);
+int exportDB(FILE *outputFile, tDBFormat format, int threadCount);
+int exportIRCodeSet(FILE *outputFile, tIRCodeSet *codeSet);
 
@@ -0,0 +1,422 @@
+/*
+    @file firmware.c
+
+    The firmware blob is little endian whatever machine writes it, and laid
+    out as sections, each aligned to eight bytes:
+
+        header
+        protocols   - one tFirmwareProtocol per gProtocol[] entry
+        code sets   - one tFirmwareCodeSet per code set, sorted by ID
+        codes       - one tFirmwareCode per code, grouped by code set and
+                      sorted by button label within it
+        streams     - a 16 bit count, then that many 16 bit periods in
+                      carrier cycles, each stream padded to four bytes
+        strings     - protocol names and button labels, not terminated
+
+    So a code set is found with a binary search on its ID, and a button with
+    a binary search of the set's codes. A stream that more than one code
+    points at - the fixed repeat streams in gRepeatStream[], or one shared
+    between duplicates - is only stored once. Streams are matched on their
+    periods rather than their addresses, as how the analysis shares the
+    adjusted ones varies with the thread count, and the blob mustn't.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include <stdint.h>
+
+#include "analyse-ir-codes.h"
+#include "analyse.h"
+#include "firmware.h"
+#include "stats.h"
+
+#define FIRMWARE_MAGIC          "IRFW"
+#define FIRMWARE_VERSION        1
+#define FIRMWARE_NO_PROTOCOL    0xFFFF
+#define FIRMWARE_NO_STREAM      0xFFFFFFFFUL
+#define FIRMWARE_MAX_PERIOD     0xFFFF
+#define FIRMWARE_MAX_COUNT      0xFFFE      /* the most periods a 16 bit count can hold, in pairs */
+
+#define ALIGN4(x)   (((x) + 3) & ~(uint64_t)3)
+#define ALIGN8(x)   (((x) + 7) & ~(uint64_t)7)
+
+/* the size of each record as written - not the size of any struct in memory */
+#define FIRMWARE_HEADER_SIZE    48
+#define FIRMWARE_PROTOCOL_SIZE  8
+#define FIRMWARE_CODESET_SIZE   16
+#define FIRMWARE_CODE_SIZE      32
+
+typedef struct {
+    const tIRStream *stream;
+    unsigned long long hash;    /* of its periods */
+    uint32_t        offset;     /* into the stream section */
+} tSharedStream;
+
+typedef struct {
+    FILE            *file;
+    uint64_t        written;
+
+    tSharedStream   *shared;    /* open addressed, keyed on the stream's periods */
+    size_t          sharedMask;
+
+    uint32_t        *streamOffset;  /* four per code, as they'll be written */
+    size_t          *codeOrder;     /* codes, sorted by label within each code set */
+    size_t          *codeSetOrder;  /* code sets, sorted by ID */
+    size_t          *codeRecord;    /* the record each code set's codes start at */
+} tFirmwareState;
+
+static tIRStream *codeStream(tIRCode *code, int i)
+{
+    switch (i)
+    {
+    case 0:  return code->first.a;
+    case 1:  return code->first.b;
+    case 2:  return code->repeat.a;
+    default: return code->repeat.b;
+    }
+}
+
+/* the periods of a stream that will be written - any past FIRMWARE_MAX_COUNT are dropped */
+static uint32_t firmwareCount(const tIRStream *stream)
+{
+    return (stream->count > FIRMWARE_MAX_COUNT) ? FIRMWARE_MAX_COUNT : stream->count;
+}
+
+static void put16(unsigned char *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static void put32(unsigned char *p, uint32_t value)
+{
+    put16(p, value);
+    put16(p + 2, value >> 16);
+}
+
+static void writeBytes(tFirmwareState *state, const void *bytes, size_t length)
+{
+    fwrite(bytes, 1, length, state->file);
+    state->written += length;
+}
+
+static void writePadding(tFirmwareState *state, uint64_t alignedTo)
+{
+    static const unsigned char padding[8] = { 0 };
+
+    writeBytes(state, padding, alignedTo - state->written);
+}
+
+/* returns the slot of a stream with the same periods, or the one it should go in */
+static tSharedStream *findStream(tFirmwareState *state, const tIRStream *stream)
+{
+    unsigned long long hash = WORD_HASH_SEED;
+    tSharedStream   *slot;
+    size_t          i;
+
+    for (i = 0; i < stream->count; ++i)
+        hash = WORD_HASH_STEP( hash, stream->period[i] );
+    hash ^= hash >> 29;
+
+    for (i = hash; ; ++i)
+    {
+        slot = &state->shared[ i & state->sharedMask ];
+        if (slot->stream == NULL)
+        {
+            slot->hash = hash;
+            return slot;
+        }
+        if ( slot->stream == stream
+          || ( slot->hash == hash && slot->stream->count == stream->count
+            && memcmp( slot->stream->period, stream->period, stream->count * sizeof(unsigned long) ) == 0 ) )
+            return slot;
+    }
+}
+
+static int compareCodeSets(const void *a, const void *b)
+{
+    size_t  i = *(const size_t *)a, j = *(const size_t *)b;
+
+    if (gStore.codeSets[i].id != gStore.codeSets[j].id)
+        return (gStore.codeSets[i].id < gStore.codeSets[j].id) ? -1 : 1;
+
+    return (i < j) ? -1 : (i > j);
+}
+
+static int compareLabels(const void *a, const void *b)
+{
+    size_t          i = *(const size_t *)a, j = *(const size_t *)b;
+    tIRCodeLabel    *labelA = &gStore.labels[i], *labelB = &gStore.labels[j];
+    int             result;
+
+    result = memcmp(labelA->label, labelB->label,
+                    (labelA->labelLength < labelB->labelLength) ? labelA->labelLength : labelB->labelLength);
+    if (result == 0 && labelA->labelLength != labelB->labelLength)
+        result = (labelA->labelLength < labelB->labelLength) ? -1 : 1;
+    if (result == 0)
+        result = (i < j) ? -1 : (i > j);
+
+    return result;
+}
+
+static void *allocate(size_t count, size_t size)
+{
+    void    *p;
+
+    p = calloc(count ? count : 1, size);
+    if (p == NULL)
+        fatalExit(-4, "unable to allocate the firmware blob tables");
+    return p;
+}
+
+int exportFirmwareBlob( FILE * file )
+{
+    tFirmwareState  state;
+    tSharedStream   *slot;
+    tIRStream       *stream;
+    tIRCodeSet      *codeSet;
+    tIRCode         *code;
+    unsigned char   record[FIRMWARE_HEADER_SIZE], *p;
+    uint64_t        protocolOffset, codeSetOffset, codeOffset, streamOffset, stringOffset;
+    uint64_t        streamBytes, stringBytes, labelBytes;
+    unsigned long   period;
+    size_t          protocolCount, size, c, r;
+    unsigned int    clipped, truncated;
+    int             i, j;
+
+    memset(&state, 0, sizeof(state));
+    state.file = file;
+
+    for (protocolCount = 0; gProtocol[protocolCount].confidence != kListEnd; ++protocolCount)
+        { }
+
+    state.streamOffset = allocate(4 * gStore.codeCount, sizeof(uint32_t));
+    state.codeOrder    = allocate(gStore.codeCount, sizeof(size_t));
+    state.codeSetOrder = allocate(gStore.codeSetCount, sizeof(size_t));
+    state.codeRecord   = allocate(gStore.codeSetCount, sizeof(size_t));
+
+    for (size = 16; size < 8 * gStore.codeCount; size <<= 1)
+        { }
+    state.shared     = allocate(size, sizeof(tSharedStream));
+    state.sharedMask = size - 1;
+
+    /* first pass - order everything, and lay out the streams */
+    for (c = 0; c < gStore.codeSetCount; ++c)
+    {
+        state.codeSetOrder[c] = c;
+
+        codeSet = &gStore.codeSets[c];
+        for (r = codeSet->firstCode; r < codeSet->firstCode + codeSet->codeCount; ++r)
+            state.codeOrder[r] = r;
+
+        qsort(&state.codeOrder[codeSet->firstCode], codeSet->codeCount, sizeof(size_t), compareLabels);
+    }
+    qsort(state.codeSetOrder, gStore.codeSetCount, sizeof(size_t), compareCodeSets);
+
+    streamBytes = 0;
+    stringBytes = 0;
+    for (c = 0; c < protocolCount; ++c)
+        stringBytes += strlen(gProtocol[c].name);
+    labelBytes = stringBytes;
+
+    r = 0;
+    for (c = 0; c < gStore.codeSetCount; ++c)
+    {
+        codeSet = &gStore.codeSets[ state.codeSetOrder[c] ];
+        state.codeRecord[c] = r;
+        r += codeSet->codeCount;
+
+        for (j = 0; j < (int)codeSet->codeCount; ++j)
+        {
+            code = &gStore.codes[ state.codeOrder[codeSet->firstCode + j] ];
+            stringBytes += labelOf(code)->labelLength;
+
+            for (i = 0; i < 4; ++i)
+            {
+                stream = codeStream(code, i);
+                state.streamOffset[4 * (code - gStore.codes) + i] = FIRMWARE_NO_STREAM;
+                if (stream == NULL)
+                    continue;
+
+                slot = findStream(&state, stream);
+                if (slot->stream == NULL)
+                {
+                    slot->stream = stream;
+                    slot->offset = streamBytes;
+                    streamBytes += ALIGN4(2 * (1 + firmwareCount(stream)));
+                }
+                state.streamOffset[4 * (code - gStore.codes) + i] = slot->offset;
+            }
+        }
+    }
+
+    protocolOffset = ALIGN8(FIRMWARE_HEADER_SIZE);
+    codeSetOffset  = protocolOffset + ALIGN8(protocolCount * FIRMWARE_PROTOCOL_SIZE);
+    codeOffset     = codeSetOffset  + ALIGN8(gStore.codeSetCount * FIRMWARE_CODESET_SIZE);
+    streamOffset   = codeOffset     + ALIGN8(gStore.codeCount * FIRMWARE_CODE_SIZE);
+    stringOffset   = streamOffset   + ALIGN8(streamBytes);
+
+    if (stringOffset + stringBytes > UINT32_MAX)
+    {
+        logError("the database is too big for a firmware blob");
+        free(state.shared);
+        free(state.streamOffset);
+        free(state.codeOrder);
+        free(state.codeSetOrder);
+        free(state.codeRecord);
+        return (-3);
+    }
+
+    memset(record, 0, sizeof(record));
+    memcpy(record, FIRMWARE_MAGIC, 4);
+    put16(record + 4,  FIRMWARE_VERSION);
+    put16(record + 6,  FIRMWARE_HEADER_SIZE);
+    put32(record + 8,  protocolCount);
+    put32(record + 12, gStore.codeSetCount);
+    put32(record + 16, gStore.codeCount);
+    put32(record + 20, protocolOffset);
+    put32(record + 24, codeSetOffset);
+    put32(record + 28, codeOffset);
+    put32(record + 32, streamOffset);
+    put32(record + 36, stringOffset);
+    put32(record + 40, streamBytes);
+    put32(record + 44, stringBytes);
+    writeBytes(&state, record, FIRMWARE_HEADER_SIZE);
+    writePadding(&state, protocolOffset);
+
+    /* protocols - the codes refer to them by index */
+    stringBytes = 0;
+    for (c = 0; c < protocolCount; ++c)
+    {
+        memset(record, 0, FIRMWARE_PROTOCOL_SIZE);
+        put32(record,     stringBytes);
+        put16(record + 4, strlen(gProtocol[c].name));
+        record[6] = gProtocol[c].encoding;
+        stringBytes += strlen(gProtocol[c].name);
+        writeBytes(&state, record, FIRMWARE_PROTOCOL_SIZE);
+    }
+    writePadding(&state, codeSetOffset);
+
+    for (c = 0; c < gStore.codeSetCount; ++c)
+    {
+        codeSet = &gStore.codeSets[ state.codeSetOrder[c] ];
+
+        memset(record, 0, FIRMWARE_CODESET_SIZE);
+        put32(record,      codeSet->id);
+        put16(record + 4,  codeSet->deviceType);
+        put16(record + 6,  codeSet->brand);
+        put32(record + 8,  state.codeRecord[c]);
+        put32(record + 12, codeSet->codeCount);
+        writeBytes(&state, record, FIRMWARE_CODESET_SIZE);
+    }
+    writePadding(&state, codeOffset);
+
+    for (c = 0; c < gStore.codeSetCount; ++c)
+    {
+        codeSet = &gStore.codeSets[ state.codeSetOrder[c] ];
+
+        for (r = codeSet->firstCode; r < codeSet->firstCode + codeSet->codeCount; ++r)
+        {
+            code = &gStore.codes[ state.codeOrder[r] ];
+
+            memset(record, 0, FIRMWARE_CODE_SIZE);
+            put16(record, (code->fingerprint.protocol != NULL)
+                            ? (uint32_t)(code->fingerprint.protocol - gProtocol) : FIRMWARE_NO_PROTOCOL);
+            record[2] = code->fingerprint.repeatType;
+            put32(record + 4,  code->fingerprint.carrierFreq);
+            put32(record + 8,  labelBytes);
+            put16(record + 12, labelOf(code)->labelLength);
+            labelBytes += labelOf(code)->labelLength;
+
+            for (i = 0; i < 4; ++i)
+                put32(record + 16 + 4 * i, state.streamOffset[4 * (code - gStore.codes) + i]);
+
+            writeBytes(&state, record, FIRMWARE_CODE_SIZE);
+        }
+    }
+    writePadding(&state, streamOffset);
+
+    /* streams, in the order they were laid out. Shared ones were only laid out the first time */
+    clipped = 0;
+    truncated = 0;
+    streamBytes = 0;
+    for (c = 0; c < gStore.codeSetCount; ++c)
+    {
+        codeSet = &gStore.codeSets[ state.codeSetOrder[c] ];
+
+        for (r = codeSet->firstCode; r < codeSet->firstCode + codeSet->codeCount; ++r)
+        {
+            code = &gStore.codes[ state.codeOrder[r] ];
+
+            for (i = 0; i < 4; ++i)
+            {
+                stream = codeStream(code, i);
+                if (stream == NULL || state.streamOffset[4 * (code - gStore.codes) + i] != streamBytes)
+                    continue;
+
+                if (stream->count > FIRMWARE_MAX_COUNT)
+                    ++truncated;
+
+                p = record;
+                put16(p, firmwareCount(stream));
+                p += 2;
+                for (j = 0; j < (int)firmwareCount(stream); ++j)
+                {
+                    period = stream->period[j];
+                    if (period > FIRMWARE_MAX_PERIOD)
+                    {
+                        period = FIRMWARE_MAX_PERIOD;
+                        ++clipped;
+                    }
+                    if (p == record + sizeof(record))
+                    {
+                        writeBytes(&state, record, p - record);
+                        p = record;
+                    }
+                    put16(p, period);
+                    p += 2;
+                }
+                writeBytes(&state, record, p - record);
+
+                streamBytes += ALIGN4(2 * (1 + firmwareCount(stream)));
+                writePadding(&state, streamOffset + streamBytes);
+            }
+        }
+    }
+    writePadding(&state, stringOffset);
+
+    if (clipped != 0)
+        logWarning("%u periods were too long for 16 bits, and were clipped", clipped);
+    if (truncated != 0)
+        logWarning("%u streams had too many periods for a 16 bit count, and were cut short", truncated);
+
+    for (c = 0; c < protocolCount; ++c)
+        writeBytes(&state, gProtocol[c].name, strlen(gProtocol[c].name));
+
+    for (c = 0; c < gStore.codeSetCount; ++c)
+    {
+        codeSet = &gStore.codeSets[ state.codeSetOrder[c] ];
+
+        for (r = codeSet->firstCode; r < codeSet->firstCode + codeSet->codeCount; ++r)
+        {
+            code = &gStore.codes[ state.codeOrder[r] ];
+            writeBytes(&state, labelOf(code)->label, labelOf(code)->labelLength);
+        }
+    }
+
+    free(state.shared);
+    free(state.streamOffset);
+    free(state.codeOrder);
+    free(state.codeSetOrder);
+    free(state.codeRecord);
+
+    if (fflush(file) != 0 || ferror(file))
+    {
+        logDebugErrno(0, "error writing to output");
+        return (-3);
+    }
+    countBytesWritten( state.written );
+    return (0);
+}
@@ -0,0 +1,10 @@
+/*
+    @file firmware.h
+
+    A blob of the adjusted codes, laid out so the IR blaster's firmware can
+    use the entries in place. Export only - it drops too much to read back.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+int exportFirmwareBlob(FILE *outputFile);
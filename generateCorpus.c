@@ -0,0 +1,537 @@
+/*
+    @file generateCorpus.c
+
+    writes a synthetic database, in the text format importDB() reads, for
+    benchmarking - the vendor database can't be shared.
+
+    Each code set uses one of the gProtocol[] templates: the bits are random,
+    but laid out the way analyzeIRStream() expects that encoding, so most of
+    the codes are identified as the protocol they were made from. Captures
+    are jittered, a mark/space bias per code plus noise per period, and a
+    few codes are noise that won't match anything. Some code sets are
+    copies of earlier ones under a new ID, as in the real database, so the
+    fingerprint cache and stream sharing get exercised.
+
+    The same seed always produces the same output.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+#include "analyse-ir-codes.h"
+
+#define MAX_PERIODS     200     /* MAX_RAW_IR_COUNT - the importer drops any more */
+#define MAX_BITS        64
+
+tReferenceFingerprint gProtocol[] =
+{
+#define defineProtocol(...)  { __VA_ARGS__ },
+#include "protocolmapping.h"
+#undef defineProtocol
+
+    { kListEnd }
+};
+
+struct {
+    tCount          count;
+    unsigned long   period[8];
+} gRepeatStream[] = {
+#define defineRepeatStream(id,...)  __VA_ARGS__,
+#include "repeatstreammapping.h"
+#undef defineRepeatStream
+    {0}
+};
+
+/* code set IDs that have a brand and device type - used first */
+const unsigned int gCodesetId[] = {
+#define defineCodesetMapping(id,deviceType,brand)  id,
+#include "codesetmapping.h"
+#undef  defineCodesetMapping
+    0
+};
+
+/* no label may have a | followed by a digit - the importer would split it there */
+const char *gButton[] = {
+    "Power", "Power On", "Power Off", "Mute", "Vol +", "Vol -", "Ch|Up", "Ch|Down",
+    "0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "Enter", "Last",
+    "Input", "Input|HDMI 1", "Input|HDMI 2", "Input|TV", "Menu", "Exit", "Guide", "Info",
+    "Up", "Down", "Left", "Right", "Select", "Back",
+    "Play", "Pause", "Stop", "Rewind", "Fast Forward", "Record", "Skip +", "Skip -",
+    NULL
+};
+
+/* how often code sets use a protocol, by its confidence */
+const unsigned long gConfidenceWeight[] = { 0, 1, 3, 8 };   /* kListEnd, kFromDB, kMeasured, kFromSpec */
+
+typedef struct {
+    unsigned long   count;
+    unsigned long   period[MAX_PERIODS];
+} tStream;
+
+typedef struct {
+    unsigned long   codes, codeSets;
+    int             jitter;         /* percent */
+    int             noise;          /* percent of codes that are random */
+    int             copies;         /* percent of code sets that copy an earlier one */
+    unsigned long long seed;
+} tOptions;
+
+/* xorshift64* - rand() isn't the same everywhere, and the output should be */
+static unsigned long long gRandom;
+
+unsigned long long nextRandom(void)
+{
+    gRandom ^= gRandom >> 12;
+    gRandom ^= gRandom << 25;
+    gRandom ^= gRandom >> 27;
+    return gRandom * 2685821657736338717ULL;
+}
+
+void seedRandom(unsigned long long seed)
+{
+    /* splitmix64, so similar seeds don't give similar streams */
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    gRandom = (seed ^ (seed >> 31)) | 1;
+}
+
+/* 0 .. range-1 */
+unsigned long randomBelow(unsigned long range)
+{
+    return (unsigned long)((nextRandom() >> 11) % range);
+}
+
+/* -1.0 .. +1.0, roughly bell-shaped */
+double randomSpread(void)
+{
+    return ( (double)randomBelow(1000001) + randomBelow(1000001) + randomBelow(1000001) ) / 1500000.0 - 1.0;
+}
+
+int symbolValues(const unsigned int *values)
+{
+    int count;
+
+    for (count = 0; count < 4 && values[count] != 0; ++count)
+        { }
+
+    return count;
+}
+
+void addPeriod(tStream *stream, unsigned long period)
+{
+    if (stream->count < MAX_PERIODS)
+        stream->period[stream->count++] = period;
+}
+
+/*
+    Pick one symbol value per bit, making sure every value turns up at
+    least twice - a value seen only once makes the encoding look 'extended'.
+*/
+void pickSymbols(int *symbol, int count, int values)
+{
+    int i, j, t;
+
+    for (i = 0; i < count; ++i)
+        symbol[i] = (i < 2 * values) ? i / 2 : (int)randomBelow(values);
+
+    for (i = count - 1; i > 0; --i)
+    {
+        j = randomBelow(i + 1);
+        t = symbol[i]; symbol[i] = symbol[j]; symbol[j] = t;
+    }
+}
+
+/*
+    Mark varies, space varies and PPM: a leading pair, if the protocol has
+    one, then a mark/space pair per symbol, a trailing mark, and the
+    inter-code gap. If there's no distinct leading space, the first symbol's
+    space takes its place, so the symbols are (space, mark) pairs instead.
+*/
+void pulseStream(tStream *stream, tReferenceFingerprint *protocol, int symbols, const int *symbol)
+{
+    int markVaries = (protocol->encoding == kMarkVaries);
+    int i = 0;
+
+    if (protocol->leading.mark != 0)
+        addPeriod(stream, protocol->leading.mark);
+    else if (markVaries)
+        addPeriod(stream, protocol->mark[ symbol[i++] ]);
+    else
+        addPeriod(stream, protocol->mark[0]);
+
+    if (protocol->leading.space != 0)
+    {
+        addPeriod(stream, protocol->leading.space);
+        for ( ; i < symbols; ++i)
+        {
+            addPeriod(stream, markVaries ? protocol->mark[ symbol[i] ] : protocol->mark[0]);
+            addPeriod(stream, markVaries ? protocol->space[0] : protocol->space[ symbol[i] ]);
+        }
+        addPeriod(stream, protocol->mark[0]);
+    }
+    else
+    {
+        for ( ; i < symbols; ++i)
+        {
+            addPeriod(stream, markVaries ? protocol->space[0] : protocol->space[ symbol[i] ]);
+            addPeriod(stream, markVaries ? protocol->mark[ symbol[i] ] : protocol->mark[0]);
+        }
+    }
+}
+
+/*
+    Biphase: each bit is two half-bit periods, space then mark for a one,
+    so adjacent halves at the same level merge into a double-length period.
+    The leading space is lost in the idle time before the code, and a
+    trailing space in the gap after it. The extended variants have one
+    double-length bit in the middle (like the RC-6 trailer bit), which
+    makes a single triple-length mark.
+    Returns the symbol count analyzeIRStream() will estimate for it.
+*/
+int biphaseStream(tStream *stream, tReferenceFingerprint *protocol, int bits, const int *bit)
+{
+    int     level[2 * MAX_BITS + 4];    /* 1 for mark, per half-bit unit */
+    int     halves, i, run, extended, units, estimate;
+
+    extended = (protocol->encoding == kBiphaseExtended) ? bits / 2 : -1;
+
+    halves = 0;
+    for (i = 0; i < bits; ++i)
+    {
+        if (i == extended)
+        {
+            level[halves++] = 0; level[halves++] = 0;
+            level[halves++] = 1; level[halves++] = 1;
+        }
+        else
+        {
+            level[halves++] = !bit[i];
+            level[halves++] = bit[i];
+        }
+    }
+
+    if (protocol->leading.mark != 0)
+        addPeriod(stream, protocol->leading.mark);
+
+    i = 0;
+    if (protocol->leading.mark == 0)
+    {
+        while (i < halves && level[i] == 0)
+            ++i;
+    }
+
+    estimate = 0;
+    while (i < halves)
+    {
+        for (run = 1; i + run < halves && level[i + run] == level[i]; ++run)
+            { }
+
+        if (i + run == halves && level[i] == 0)
+            break;  /* becomes part of the gap */
+
+        units = (run < 3) ? run : 3;
+        if (units < 3)
+            estimate += units;
+
+        if (level[i])
+            addPeriod(stream, (units == 3) ? protocol->mark[0] * 3 : protocol->mark[units - 1]);
+        else
+            addPeriod(stream, (units == 3) ? protocol->space[0] * 3 : protocol->space[units - 1]);
+        i += run;
+    }
+
+    return estimate / 2;
+}
+
+/* the symbol count this protocol has most often, or its only one */
+int pickSymbolCount(tReferenceFingerprint *protocol)
+{
+    int counts;
+
+    for (counts = 0; counts < SYMBOL_ARRAY_SIZE && protocol->symbolCounts[counts] != 0; ++counts)
+        { }
+
+    return protocol->symbolCounts[ randomBelow(counts) ];
+}
+
+/* the gap brings the total up to the protocol's duration, if there's room */
+void addGap(tStream *stream, unsigned long duration)
+{
+    unsigned long sum = 0, longest = 0, i;
+
+    for (i = 0; i < stream->count; ++i)
+    {
+        sum += stream->period[i];
+        if (stream->period[i] > longest)
+            longest = stream->period[i];
+    }
+
+    addPeriod(stream, (sum + 2 * longest < duration) ? duration - sum : 2 * longest);
+}
+
+/* the first half of a toggle code, or the only half. 'bits' are reused for the second half */
+void buildStream(tStream *stream, tReferenceFingerprint *protocol, int *bits, int *bit)
+{
+    int symbols, tries, i;
+
+    stream->count = 0;
+
+    switch (protocol->encoding)
+    {
+    case kBiphase:
+    case kBiphaseExtended:
+    case kAmbiguous:
+        symbols = pickSymbolCount(protocol);
+
+        /* one extra bit for the start bit that's lost to the idle time */
+        for (tries = 0; tries < 8; ++tries)
+        {
+            *bits = symbols + 1;
+            for (i = 0; i < *bits; ++i)
+                bit[i] = randomBelow(2);
+
+            /* starts with a one (space first), the extended bit sits between a one and a zero */
+            bit[0] = 1;
+            if (protocol->encoding == kBiphaseExtended)
+            {
+                bit[*bits / 2 - 1] = 1;
+                bit[*bits / 2 + 1] = 0;
+            }
+            else if (protocol->encoding == kAmbiguous)
+            {
+                /* RC-5 '0' - no double-length marks */
+                for (i = 1; i < *bits; ++i)
+                    bit[i] = 1;
+            }
+
+            stream->count = 0;
+            if (biphaseStream(stream, protocol, *bits, bit) == symbols)
+                break;
+        }
+        break;
+
+    default:
+        *bits = pickSymbolCount(protocol);
+        pickSymbols(bit, *bits, symbolValues(protocol->encoding == kMarkVaries ? protocol->mark : protocol->space));
+        pulseStream(stream, protocol, *bits, bit);
+        break;
+    }
+    addGap(stream, protocol->duration);
+}
+
+/* 20 to 60 random periods - codes from something no template covers */
+void noiseStream(tStream *stream)
+{
+    unsigned long count, i;
+
+    count = 20 + 2 * randomBelow(21);
+    stream->count = 0;
+    for (i = 0; i < count; ++i)
+        addPeriod(stream, 12 + randomBelow(489));
+
+    addPeriod(stream, 1000 + randomBelow(3000));
+}
+
+/*
+    Scale from the protocol's carrier to the code set's, then add capture
+    error - the receiver stretches marks and shrinks spaces by much the same
+    amount throughout a code, and every period has some noise of its own.
+*/
+void writeStream(FILE *output, char prefix, tStream *stream, double scale, int jitter)
+{
+    double          bias;
+    long            period;
+    unsigned long   i;
+
+    bias = randomSpread() * jitter / 200.0;
+    for (i = 0; i < stream->count; ++i)
+    {
+        period = (long)( stream->period[i] * scale
+                         * (1.0 + ((i & 1) ? -bias : bias) + randomSpread() * jitter / 100.0) + 0.5 );
+        fprintf(output, "%c%ld", (i == 0) ? prefix : ',', (period > 0) ? period : 1);
+    }
+}
+
+void writeCode(FILE *output, unsigned int id, const char *label, tReferenceFingerprint *protocol,
+               unsigned long carrier, const char *repeatType, const tOptions *options)
+{
+    tStream first, second;
+    int     bit[MAX_BITS + 1], bits;
+    double  scale;
+
+    if (protocol == NULL)
+    {
+        noiseStream(&first);
+        fprintf(output, "%u|%lu|Full_Repeat|%s", id, carrier, label);
+        writeStream(output, '|', &first, 1.0, 0);
+        fprintf(output, "||\r\n");
+        return;
+    }
+
+    scale = (double)carrier / protocol->carrierFreq;
+
+    buildStream(&first, protocol, &bits, bit);
+
+    fprintf(output, "%u|%lu|%s|%s", id, carrier, repeatType, label);
+    writeStream(output, '|', &first, scale, options->jitter);
+
+    if (strcmp(repeatType, "Toggle") == 0)
+    {
+        /* the same code, with the toggle bit (the one after the start bits) flipped */
+        bit[2] = !bit[2];
+        second.count = 0;
+        biphaseStream(&second, protocol, bits, bit);
+        addGap(&second, protocol->duration);
+        writeStream(output, '^', &second, scale, options->jitter);
+    }
+
+    if (protocol->repeatStream != kUnknownRepeatStream)
+    {
+        first.count = gRepeatStream[protocol->repeatStream].count;
+        memcpy(first.period, gRepeatStream[protocol->repeatStream].period, first.count * sizeof(unsigned long));
+        writeStream(output, '|', &first, scale, options->jitter);
+        fprintf(output, "|\r\n");
+    }
+    else fprintf(output, "||\r\n");
+}
+
+/*
+    Everything about a code set comes from its own random sequence, seeded
+    from its 'source', so a copy of an earlier set is identical to it.
+*/
+void writeCodeSet(FILE *output, unsigned int id, unsigned long source, unsigned long codes,
+                  const tOptions *options)
+{
+    static const char *repeatTypes[] = { "Full_Repeat", "Partial_Repeat", "Repeat" };
+    tReferenceFingerprint *protocol;
+    const char      *repeatType;
+    char            label[64];
+    unsigned long   carrier, i, buttons, weight, pick;
+
+    seedRandom(options->seed * 1000003 + source);
+
+    /* the protocols from the spec are the common ones, those found in the database the rarest */
+    weight = 0;
+    for (protocol = gProtocol; protocol->confidence != kListEnd; ++protocol)
+        weight += gConfidenceWeight[protocol->confidence];
+
+    pick = randomBelow(weight);
+    for (protocol = gProtocol; pick >= gConfidenceWeight[protocol->confidence]; ++protocol)
+        pick -= gConfidenceWeight[protocol->confidence];
+
+    /* most code sets are captured at the nominal carrier, some a few percent off */
+    carrier = protocol->carrierFreq;
+    if (randomBelow(5) == 0)
+        carrier = (carrier + (long)(randomSpread() * carrier * 0.03)) / 100 * 100;
+
+    switch (protocol->encoding)
+    {
+    case kBiphase:
+    case kBiphaseExtended:
+    case kAmbiguous:
+        repeatType = "Toggle";
+        break;
+    default:
+        repeatType = (protocol->repeatStream != kUnknownRepeatStream) ? "Full_Repeat" : repeatTypes[ randomBelow(3) ];
+        break;
+    }
+
+    for (buttons = 0; gButton[buttons] != NULL; ++buttons)
+        { }
+
+    for (i = 0; i < codes; ++i)
+    {
+        if (i < buttons)
+            strcpy(label, gButton[i]);
+        else
+            sprintf(label, "%s %lu", gButton[i % buttons], i / buttons + 1);
+
+        if ((int)randomBelow(100) < options->noise)
+            writeCode(output, id, label, NULL, carrier, NULL, options);
+        else
+            writeCode(output, id, label, protocol, carrier, repeatType, options);
+    }
+}
+
+void usage(const char *myName)
+{
+    fprintf(stderr,
+"Usage: %s [options] > corpus.txt\n"
+"    -c <count>   number of codes (default 10000)\n"
+"    -s <count>   number of code sets (default one per 12 codes)\n"
+"    -j <percent> capture jitter (default 3)\n"
+"    -n <percent> codes that are noise, matching no protocol (default 2)\n"
+"    -d <percent> code sets that duplicate an earlier one (default 20)\n"
+"    -r <seed>    random seed (default 1)\n",
+            myName);
+    exit(-1);
+}
+
+int main(int argc, const char *argv[])
+{
+    tOptions        options;
+    unsigned long   set, remaining, codes, source, mapped;
+    unsigned int    id;
+    int             i;
+
+    options.codes    = 10000;
+    options.codeSets = 0;
+    options.jitter   = 3;
+    options.noise    = 2;
+    options.copies   = 20;
+    options.seed     = 1;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 >= argc || !isdigit(argv[i + 1][0]))
+            usage(argv[0]);
+
+        switch (argv[i][1])
+        {
+        case 'c': options.codes    = strtoul(argv[++i], NULL, 10); break;
+        case 's': options.codeSets = strtoul(argv[++i], NULL, 10); break;
+        case 'j': options.jitter   = atoi(argv[++i]); break;
+        case 'n': options.noise    = atoi(argv[++i]); break;
+        case 'd': options.copies   = atoi(argv[++i]); break;
+        case 'r': options.seed     = strtoull(argv[++i], NULL, 10); break;
+        default:  usage(argv[0]); break;
+        }
+    }
+
+    if (options.codeSets == 0)
+        options.codeSets = (options.codes + 11) / 12;
+    if (options.codeSets > options.codes)
+        options.codeSets = options.codes;
+
+    for (mapped = 0; gCodesetId[mapped] != 0; ++mapped)
+        { }
+
+    remaining = options.codes;
+    for (set = 0; set < options.codeSets; ++set)
+    {
+        /* code set sizes vary, but average out to what's left */
+        seedRandom(options.seed * 1000003 + options.codeSets + set);
+        if (set == options.codeSets - 1)
+            codes = remaining;
+        else
+            codes = 1 + randomBelow( 2 * remaining / (options.codeSets - set) - 1 );
+
+        source = set;
+        if (set > 0 && (int)randomBelow(100) < options.copies)
+            source = randomBelow(set);
+
+        /* the IDs that have brand and device type mappings are used first */
+        id = (set < mapped) ? gCodesetId[set] : 1000000 + set;
+
+        writeCodeSet(stdout, id, source, codes, &options);
+        remaining -= codes;
+    }
+
+    if (fflush(stdout) != 0 || ferror(stdout))
+    {
+        perror("error writing corpus");
+        return (-3);
+    }
+    return (0);
+}
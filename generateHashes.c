@@ -8,8 +8,8 @@
     This seriously speeds up comparisons of a string against a dictionary
     of fixed strings, in the same way using a hash table does, and makes
     the code easier to write & maintain.
-    Note that this tool does not check for hash collisions. Presumably a
-    collision would cause a compiler error if used in a switch statement.
+    Two strings that hash to the same value make this exit with an error,
+    failing the build, rather than leaving it to a duplicate case label.
 
     Copyright 2011, Paul Chambers. All Rights Reserved.
 */
@@ -22,6 +22,9 @@ const char *gStringConstants[] = {
     "Partial_Repeat",
     "Repeat",
     "Toggle",
+    "text",
+    "binary",
+    "firmware",
     NULL
 };
 
@@ -45,7 +48,7 @@ const char *stringToSymbol(const char *str)
     char *d, *dest;
     int capitalize = 0;
 
-    dest = calloc( strlen(s), sizeof(char) );
+    dest = calloc( strlen(s) + 1, sizeof(char) );
     d = dest;
 
     while (*s != '\0')
@@ -65,7 +68,20 @@ int main(int UNUSED(argc), char ** UNUSED(argv))
 {
     const char *string, *symbol;
     unsigned long hash;
-    int i;
+    int i, j;
+
+    for (i = 0; gStringConstants[i] != NULL; ++i)
+    {
+        for (j = 0; j < i; ++j)
+        {
+            if (stringToHash(gStringConstants[i]) == stringToHash(gStringConstants[j]))
+            {
+                fprintf(stderr, "generateHashes: ### \"%s\" and \"%s\" have the same hash\n",
+                        gStringConstants[j], gStringConstants[i]);
+                return 1;
+            }
+        }
+    }
 
     printf("/* automatically generated by generateHashes - DO NOT EDIT! */\n");
 
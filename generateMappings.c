@@ -0,0 +1,280 @@
+/*
+    @file generateMappings.c
+
+    builds minimal perfect hash tables for the code set ID and brand name
+    mappings at build time.
+
+    Uses 'hash and displace': keys are first hashed into buckets, then the
+    buckets are placed largest first, searching for a seed (displacement)
+    per bucket that puts every key in it into a free slot. Looking a key up
+    is then two hashes and one comparison, however big the table gets.
+
+    Unlike generateHashes, collisions are checked for: a key that can't be
+    placed, or a slot that doesn't lead back to its key, makes this exit
+    with an error, failing the build.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+#include "analyse-ir-codes.h"   /* contains the hash functions */
+
+#define MAX_SEED    (1 << 20)
+
+typedef struct {
+    unsigned int    id;
+    const char      *deviceType;
+    const char      *brand;
+} tCodesetEntry;
+
+tCodesetEntry gCodesets[] = {
+#define defineCodesetMapping(id,deviceType,brand)  { id, #deviceType, #brand },
+#include "codesetmapping.h"
+#undef  defineCodesetMapping
+    { 0, NULL, NULL }
+};
+
+typedef struct {
+    const char      *symbol;
+    const char      *name;
+} tBrandEntry;
+
+tBrandEntry gBrands[] = {
+#define defineBrand(id,string)  { #id, string },
+#include "brandmapping.h"
+#undef  defineBrand
+    { NULL, NULL }
+};
+
+/* the keys of the table being built, abstracted so both tables share the search */
+typedef struct {
+    int             count;
+    unsigned int    (*hash)(int key, unsigned int seed);
+    int             (*same)(int keyA, int keyB);
+} tKeySet;
+
+unsigned int hashCodesetKey(int key, unsigned int seed)
+{
+    return hashId(gCodesets[key].id, seed);
+}
+
+int sameCodesetKey(int keyA, int keyB)
+{
+    return gCodesets[keyA].id == gCodesets[keyB].id;
+}
+
+unsigned int hashBrandKey(int key, unsigned int seed)
+{
+    return hashName(gBrands[key].name, strlen(gBrands[key].name), seed);
+}
+
+int sameBrandKey(int keyA, int keyB)
+{
+    return strcmp(gBrands[keyA].name, gBrands[keyB].name) == 0;
+}
+
+/* for qsort() - biggest bucket first, then in bucket order, so the output doesn't vary */
+static int *gBucketSize;
+
+int compareBuckets(const void *a, const void *b)
+{
+    int bucketA = *(const int *)a, bucketB = *(const int *)b;
+
+    if (gBucketSize[bucketA] != gBucketSize[bucketB])
+        return gBucketSize[bucketB] - gBucketSize[bucketA];
+
+    return bucketA - bucketB;
+}
+
+/*
+    fills in displacement[bucketCount] and slot[keys->count] (the key in each slot).
+    keys listed in 'keys' must be unique.
+*/
+int buildPerfectHash(const tKeySet *keys, const char *what, int bucketCount,
+                     unsigned int *displacement, int *slot)
+{
+    int *bucketOf, *bucketSize, *bucketStart, *bucketKeys, *order, *placed;
+    int i, j, k, b, size;
+    unsigned int seed;
+
+    bucketOf    = calloc(keys->count, sizeof(int));
+    bucketSize  = calloc(bucketCount, sizeof(int));
+    bucketStart = calloc(bucketCount + 1, sizeof(int));
+    bucketKeys  = calloc(keys->count, sizeof(int));
+    order       = calloc(bucketCount, sizeof(int));
+    if (bucketOf == NULL || bucketSize == NULL || bucketStart == NULL || bucketKeys == NULL || order == NULL)
+    {
+        fprintf(stderr, "generateMappings: ### out of memory building the %s table\n", what);
+        return 0;
+    }
+
+    for (i = 0; i < keys->count; ++i)
+    {
+        bucketOf[i] = keys->hash(i, 0) % bucketCount;
+        ++bucketSize[ bucketOf[i] ];
+        slot[i] = -1;
+    }
+
+    /* the keys grouped by bucket, each group in key order */
+    for (b = 0; b < bucketCount; ++b)
+        bucketStart[b + 1] = bucketStart[b] + bucketSize[b];
+    for (i = 0; i < keys->count; ++i)
+        bucketKeys[ bucketStart[ bucketOf[i] ]++ ] = i;
+    for (b = 0; b < bucketCount; ++b)
+        bucketStart[b] -= bucketSize[b];
+
+    /* place the biggest buckets first, while there's most room */
+    for (b = 0; b < bucketCount; ++b)
+        order[b] = b;
+    gBucketSize = bucketSize;
+    qsort(order, bucketCount, sizeof(int), compareBuckets);
+
+    for (b = 0; b < bucketCount; ++b)
+    {
+        displacement[order[b]] = 0;
+
+        size   = bucketSize[ order[b] ];
+        placed = &bucketKeys[ bucketStart[ order[b] ] ];
+        if (size == 0)
+            continue;
+
+        for (seed = 1; seed < MAX_SEED; ++seed)
+        {
+            for (k = 0; k < size; ++k)
+            {
+                j = keys->hash(placed[k], seed) % keys->count;
+                if (slot[j] != -1)
+                    break;
+                slot[j] = placed[k];
+            }
+            if (k == size)
+                break;
+
+            /* didn't fit - undo, and try the next seed */
+            while (k-- > 0)
+                slot[ keys->hash(placed[k], seed) % keys->count ] = -1;
+        }
+        if (seed == MAX_SEED)
+        {
+            fprintf(stderr, "generateMappings: ### unable to place %d colliding %s keys\n", size, what);
+            return 0;
+        }
+        displacement[order[b]] = seed;
+    }
+
+    /* belt and braces - every key must lead back to itself */
+    for (i = 0; i < keys->count; ++i)
+    {
+        j = keys->hash(i, displacement[ keys->hash(i, 0) % bucketCount ]) % keys->count;
+        if (slot[j] == -1 || !keys->same(slot[j], i))
+        {
+            fprintf(stderr, "generateMappings: ### %s key %d collides in slot %d\n", what, i, j);
+            return 0;
+        }
+    }
+
+    free(bucketOf);
+    free(bucketSize);
+    free(bucketStart);
+    free(bucketKeys);
+    free(order);
+    return 1;
+}
+
+void printDisplacements(const char *name, unsigned int *displacement, int count)
+{
+    int i;
+
+    printf("static const unsigned int %s[%d] = {", name, count);
+    for (i = 0; i < count; ++i)
+        printf("%s%u,", (i % 12 == 0) ? "\n    " : " ", displacement[i]);
+    printf("\n};\n\n");
+}
+
+int main(int UNUSED(argc), char ** UNUSED(argv))
+{
+    tKeySet         keys;
+    unsigned int    *displacement;
+    int             *unique, *slot;
+    int             count, i, j, buckets;
+
+    printf("/* automatically generated by generateMappings - DO NOT EDIT! */\n\n");
+
+    /* code sets - later duplicates of an ID never matched the old linear lookup, so drop them */
+    for (count = 0; gCodesets[count].id != 0; ++count)
+        { }
+
+    unique = calloc(count, sizeof(int));
+    j = 0;
+    for (i = 0; i < count; ++i)
+    {
+        int k;
+        for (k = 0; k < j; ++k)
+        {
+            if (gCodesets[unique[k]].id == gCodesets[i].id)
+                break;
+        }
+        if (k < j)
+            fprintf(stderr, "generateMappings: code set %u is mapped more than once, ignoring %s %s\n",
+                        gCodesets[i].id, gCodesets[i].deviceType, gCodesets[i].brand);
+        else
+            unique[j++] = i;
+    }
+    for (i = 0; i < j; ++i)
+        gCodesets[i] = gCodesets[unique[i]];
+    count = j;
+
+    keys.count = count;
+    keys.hash  = hashCodesetKey;
+    keys.same  = sameCodesetKey;
+    buckets = (count + 3) / 4;
+    displacement = calloc(buckets, sizeof(unsigned int));
+    slot = calloc(count, sizeof(int));
+    if (!buildPerfectHash(&keys, "code set", buckets, displacement, slot))
+        return 1;
+
+    printf("#define CODESET_HASH_BUCKETS %d\n", buckets);
+    printf("#define CODESET_HASH_SLOTS   %d\n\n", count);
+    printDisplacements("gCodesetDisplacement", displacement, buckets);
+    printf("static const struct {\n    unsigned int id;\n    tDeviceType deviceType;\n    tBrand brand;\n} gCodesetSlot[%d] = {\n", count);
+    for (i = 0; i < count; ++i)
+        printf("    { %u, %s, %s },\n", gCodesets[slot[i]].id, gCodesets[slot[i]].deviceType, gCodesets[slot[i]].brand);
+    printf("};\n\n");
+    free(displacement);
+    free(slot);
+    free(unique);
+
+    /* brand names */
+    for (count = 0; gBrands[count].name != NULL; ++count)
+    {
+        for (j = 0; j < count; ++j)
+        {
+            if (strcmp(gBrands[j].name, gBrands[count].name) == 0)
+            {
+                fprintf(stderr, "generateMappings: ### brand name \"%s\" is defined more than once\n", gBrands[count].name);
+                return 1;
+            }
+        }
+    }
+
+    keys.count = count;
+    keys.hash  = hashBrandKey;
+    keys.same  = sameBrandKey;
+    buckets = (count + 3) / 4;
+    displacement = calloc(buckets, sizeof(unsigned int));
+    slot = calloc(count, sizeof(int));
+    if (!buildPerfectHash(&keys, "brand", buckets, displacement, slot))
+        return 1;
+
+    printf("#define BRAND_HASH_BUCKETS %d\n", buckets);
+    printf("#define BRAND_HASH_SLOTS   %d\n\n", count);
+    printDisplacements("gBrandDisplacement", displacement, buckets);
+    printf("static const struct {\n    const char *name;\n    tBrand brand;\n} gBrandSlot[%d] = {\n", count);
+    for (i = 0; i < count; ++i)
+        printf("    { \"%s\", %s },\n", gBrands[slot[i]].name, gBrands[slot[i]].symbol);
+    printf("};\n");
+    free(displacement);
+    free(slot);
+
+    return 0;
+}
@@ -7,27 +7,49 @@
 #include "common.h"
 
 #include <sys/param.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <errno.h>
 #include <dirent.h>
 
 #include "analyse-ir-codes.h"
 #include "import.h"
+#include "binarydb.h"
+#include "scan.h"
+#include "store.h"
+#include "stats.h"
 
 #include "stringHashes.h"
+#include "mappingHashes.h"
+
+/* a slice of the mapped input, ending on a line boundary, parsed by one thread */
+typedef struct {
+    pthread_t       thread;
+    const char      *start, *end;
+    int             firstLine;
+    int             lineCount;
+    tImportState    state;
+    tCodeStore      store;
+    tArena          arena;
+} tImportChunk;
+
+
+/* returns kBrandUnknown if the name isn't recognised */
+tBrand brandFromName(const char *name, size_t length)
+{
+    unsigned int i;
+
+    i = hashName( name, length, 0 ) % BRAND_HASH_BUCKETS;
+    i = hashName( name, length, gBrandDisplacement[i] ) % BRAND_HASH_SLOTS;
 
-struct {
-        unsigned int    id;
-        tDeviceType deviceType;
-        tBrand      brand;
-} gCodesetMapping[] = {
-#define defineCodesetMapping(id,deviceType,brand)  { id, deviceType, brand },
-#include "codesetmapping.h"
-#undef  defineCodesetMapping
-    { 0, 0, 0 }
-};
+    if ( strncmp( gBrandSlot[i].name, name, length ) == 0 && gBrandSlot[i].name[length] == '\0' )
+        return gBrandSlot[i].brand;
 
+    return kBrandUnknown;
+}
 
-tIRStream *dupIRStream(tRawIRStream *raw)
+tIRStream *dupIRStream(tArena *arena, tRawIRStream *raw)
 {
     tIRStream *result;
     tCount i;
@@ -35,7 +57,7 @@ tIRStream *dupIRStream(tRawIRStream *raw)
     if (raw == NULL || raw->count == 0)
         return NULL;
     
-    result = calloc(1, sizeof(tIRStream) + raw->count * sizeof(int));
+    result = arenaAlloc(arena, sizeof(tIRStream) + raw->count * sizeof(unsigned long));
     if (result != NULL)
     {
         result->count = raw->count;
@@ -46,19 +68,99 @@ tIRStream *dupIRStream(tRawIRStream *raw)
     return result;
 }
 
+/* keeps the table no more than half full. Returns zero if it can't */
+int growStreamTable( tStreamTable *table )
+{
+    tStreamSlot *old = table->slot;
+    size_t      oldSize = table->size, i, j;
+
+    if ( (table->count + 1) * 2 <= table->size )
+        return 1;
+
+    table->size = (oldSize != 0) ? oldSize * 2 : 1024;
+    table->slot = calloc( table->size, sizeof(tStreamSlot) );
+    if (table->slot == NULL)
+    {
+        table->slot = old;
+        table->size = oldSize;
+        return 0;
+    }
+
+    for (i = 0; i < oldSize; ++i)
+    {
+        if (old[i].stream == NULL)
+            continue;
+
+        for (j = old[i].hash & (table->size - 1); table->slot[j].stream != NULL; j = (j + 1) & (table->size - 1))
+            { }
+        table->slot[j] = old[i];
+    }
+    free(old);
 
-unsigned long parseNumber(const char **str, int lineNumber, int *error)
+    return 1;
+}
+
+/* forget everything in the table, e.g. when the arena its streams came from is reset */
+void clearStreamTable( tStreamTable *table )
 {
-    const char      *p = *str;
-    unsigned long   number = 0;
+    free( table->slot );
+    table->slot  = NULL;
+    table->size  = 0;
+    table->count = 0;
+}
 
-    while (*p != '\0' && isdigit(*p))
-        number = (number * 10) + (*p++ - '0');
-        
-    switch (*p)
+/*
+    returns the stream already in the table with the same periods, if
+    there is one, otherwise a new copy of raw (which is added to the table).
+*/
+tIRStream *internIRStream( tArena *arena, tStreamTable *table, tRawIRStream *raw )
+{
+    unsigned long long hash = WORD_HASH_SEED;
+    tIRStream   *stream;
+    tCount      i;
+    size_t      j;
+
+    if (raw->count == 0)
+        return NULL;
+
+    if ( !growStreamTable( table ) )
+        return dupIRStream( arena, raw );   /* no sharing, but still correct */
+
+    for (i = 0; i < raw->count; ++i)
+        hash = WORD_HASH_STEP( hash, raw->period[i] );
+    hash ^= hash >> 29;
+
+    for (j = hash & (table->size - 1); table->slot[j].stream != NULL; j = (j + 1) & (table->size - 1))
+    {
+        stream = table->slot[j].stream;
+        if ( table->slot[j].hash == hash && stream->count == raw->count
+          && memcmp( stream->period, raw->period, raw->count * sizeof(unsigned long) ) == 0 )
+            return stream;
+    }
+
+    stream = dupIRStream( arena, raw );
+    if (stream != NULL)
+    {
+        table->slot[j].hash   = hash;
+        table->slot[j].stream = stream;
+        ++table->count;
+    }
+    return stream;
+}
+
+unsigned long parseNumber(const char **str, const char *end, int lineNumber, int *error)
+{
+    const char      *p;
+    unsigned long   number;
+
+    p = scanDigits( *str, end );
+    number = digitsToNumber( *str, p - *str );
+
+    switch (p < end ? *p : '\0')
     {
     case '\0':
         --p;
+        /* fall through */
     case '\r':
     case '\n':
         logError("truncated number field on line %d", lineNumber);
@@ -70,7 +172,7 @@ unsigned long parseNumber(const char **str, int lineNumber, int *error)
 
     default:
         logError("non-digits found in a number field on line %d", lineNumber);
-        logError("%s", *str);
+        logError("%.*s", (int)(end - *str), *str);
         *error = 1;
         break;
     }
@@ -79,17 +181,17 @@ unsigned long parseNumber(const char **str, int lineNumber, int *error)
     return number;
 }
 
-unsigned long hashString(const char **str, int lineNumber, int *error )
+unsigned long hashString(const char **str, const char *end, int lineNumber, int *error )
 {
     const char      *p = *str;
     unsigned long   hash = 0;
 
-    while (*p != '\0' && *p != '|')
+    while (p < end && *p != '|')
     {
         hash = STRING_HASH_STEP(hash, *p++);
     }
 
-    if (*p == '\0')
+    if (p >= end)
     {
         logError("truncated text field on line %d", lineNumber);
         --p;
@@ -99,12 +201,12 @@ unsigned long hashString(const char **str, int lineNumber, int *error )
     return hash;
 }
 
-tRepeatType parseRepeatype( const char **str, int lineNumber, int *error )
+tRepeatType parseRepeatype( const char **str, const char *end, int lineNumber, int *error )
 {
     tRepeatType result;
     unsigned long hash;
     
-    hash = hashString( str, lineNumber, error );
+    hash = hashString( str, end, lineNumber, error );
 
     switch ( hash )
     {
@@ -129,7 +231,7 @@ tRepeatType parseRepeatype( const char **str, int lineNumber, int *error )
         break;
 
     default:
-        logError("unknown repeat behavior \'%s\' (hash 0x%08lx) on line %d", *str, hash, lineNumber);
+        logError("unknown repeat behavior \'%.*s\' (hash 0x%08lx) on line %d", (int)(end - *str), *str, hash, lineNumber);
         result = kUnknownRepeat;
         break;
     }
@@ -138,21 +240,21 @@ tRepeatType parseRepeatype( const char **str, int lineNumber, int *error )
 /*
     Since the label field can contain |, compensate with an ugly hack
     scan forward to the irstream field boundry (| followed by a digit)
+
+    The label is returned as a view into the line - it is not terminated,
+    and only copied if the caller provides somewhere to put it.
 */
-char *parseLabel(const char **str, int lineNumber, int *error)
+const char *parseLabel(const char **str, const char *end, int lineNumber, int *error, unsigned int *length)
 {
     const char  *p, *e;
-    int         len;
 
     p = *str;
-    e = *str;
 
     /* find the right | - the one immediately followed by a digit */
-    while ( *e != '\0' && ( *e != '|' || !isdigit( e[1] ) ) )
-        { ++e; }
+    e = scanLabelEnd( p, end );
 
-    len = e - p;
-    if (*e == '\0')
+    *length = e - p;
+    if (e >= end)
     {
         logError("truncated label field on line %d", lineNumber);
         --e;
@@ -160,13 +262,13 @@ char *parseLabel(const char **str, int lineNumber, int *error)
     }
     *str = e + 1;
 
-    return strndup( p, len );
+    return p;
 }
 
-void parseIRStream( const char **str, int lineNumber, int *error, tIRStream **streamA, tIRStream **streamB )
+void parseIRStream( tImportState *state, const char **str, const char *end, int lineNumber, int *error, tIRStream **streamA, tIRStream **streamB )
 {
     tRawIRStream    *theCode, codeA, codeB;
-    const char      *p = *str;
+    const char      *p = *str, *e;
     int             done, seenDigits;
     unsigned long   number;
 
@@ -177,7 +279,7 @@ void parseIRStream( const char **str, int lineNumber, int *error, tIRStream **st
     number = 0;
     seenDigits = 0;
     do {
-        switch (*p)
+        switch (p < end ? *p : '\0')
         {
         case '\0':  /* just to be safe */
             logError("truncated IR Stream field on line %d", lineNumber);
@@ -210,12 +312,15 @@ void parseIRStream( const char **str, int lineNumber, int *error, tIRStream **st
         default:
             if (isdigit(*p))
             {
-                number = (number * 10) + (*p - '0');
+                /* take the whole run of digits in one go - number is always zero here */
+                e = scanDigits( p, end );
+                number = digitsToNumber( p, e - p );
                 seenDigits = 1;
+                p = e - 1;  /* precompensate for the increment of p later */
             }
             else
             {
-                logError("invalid characters found in an irstream field: %s", *str);
+                logError("invalid characters found in an irstream field: %.*s", (int)(end - *str), *str);
                 *error = 1;
                 done = 1;
             }
@@ -225,27 +330,134 @@ void parseIRStream( const char **str, int lineNumber, int *error, tIRStream **st
     } while (!done);
     
     if (streamA != NULL)
-        *streamA = dupIRStream( &codeA );
+        *streamA = internIRStream( state->arena, &state->streams, &codeA );
 
     if (streamB != NULL)
-        *streamB = dupIRStream( &codeB );
+        *streamB = internIRStream( state->arena, &state->streams, &codeB );
         
     *str = p;
 }
 
-int importDB( FILE *  file )
+/*
+    parse one line of the database, [p, end), and add the resulting code
+    to the store. The line need not be NUL-terminated.
+*/
+void importLine( tImportState *state, const char *p, const char *end, int lineNumber )
 {
-    int     lineNumber;
-    char    line[1024];
-
-    const char *p;
+    const char  *label;
     int         i;
     unsigned long number;
-    
+
     int         fieldNumber;
     int         finished;
-    tIRCodeSet  *codeSet = NULL;
-    tIRCode     *code    = NULL;
+    tCodeStore  *store = state->store;
+    tIRCodeSet  *codeSet;
+    tIRCode     *code = NULL;
+    tIRCodeLabel *codeLabel = NULL;
+
+    fieldNumber = 0;
+    finished = 0;
+
+    do {
+        switch (fieldNumber)
+        {
+        case 0:
+            while (p < end && isspace(*p))
+                { ++p; }
+
+            if ( p >= end || *p == '#' || *p == ';')
+                finished = 1;
+
+            logDebug(2, "line start: %.*s", (int)(end - p), p);
+            break;
+
+        case 1: /* code set ID */
+            number = parseNumber(&p, end, lineNumber, &finished);
+            logDebug(2, "code set ID: %ld", number);
+
+            /* take care of the code set */
+            codeSet = (store->codeSetCount > 0) ? &store->codeSets[store->codeSetCount - 1] : NULL;
+            if (codeSet == NULL || codeSet->id != number)
+            {
+                if (codeSet != NULL && state->completed != NULL)
+                {
+                    /* streaming - hand off the finished code set, then start afresh */
+                    state->completed( codeSet, state->context );
+                    arenaReset( state->arena );
+                    clearStreamTable( &state->streams );
+                    resetCodeStore( store );
+                }
+
+                codeSet = addCodeSet( store );
+                codeSet->id = number;
+                /* look up the brand and device type */
+                i = hashId( number, 0 ) % CODESET_HASH_BUCKETS;
+                i = hashId( number, gCodesetDisplacement[i] ) % CODESET_HASH_SLOTS;
+                if (gCodesetSlot[i].id == number)
+                {
+                    codeSet->deviceType = gCodesetSlot[i].deviceType;
+                    codeSet->brand      = gCodesetSlot[i].brand;
+                }
+                else if ( !(state->continues && store->codeSetCount == 1 && number == state->continuedId))
+                    logWarning("Codeset %lu has no mapping information on line %d", number, lineNumber);
+            }
+
+            /* add a new IRCode to the code set */
+            code = addCode( store );
+            codeLabel = &store->labels[store->codeCount - 1];
+            codeLabel->lineNumber = lineNumber;
+            break;
+
+        case 2: /* carrier freq */
+            code->fingerprint.carrierFreq = parseNumber( &p, end, lineNumber, &finished );
+            logDebug(2, "carrier freq: %ld", code->fingerprint.carrierFreq);
+            break;
+
+        case 3: /* repeat behavior */
+            code->fingerprint.repeatType = parseRepeatype( &p, end, lineNumber, &finished );
+            break;
+
+        case 4: /* button label */
+            label = parseLabel( &p, end, lineNumber, &finished, &codeLabel->labelLength );
+            if (state->copyLabels)
+                label = arenaStrndup( &store->labelText, label, codeLabel->labelLength );
+            codeLabel->label = label;
+            logDebug(3, "button label: \'%.*s\'", (int)codeLabel->labelLength, codeLabel->label);
+            break;
+
+        case 5: /* first code */
+            logDebug(2, "first stream: %.*s", (int)(end - p), p);
+            parseIRStream( state, &p, end, lineNumber, &finished, &code->first.a, &code->first.b );
+            break;
+
+        case 6: /* repeat code */
+            logDebug(2, "repeat stream: %.*s", (int)(end - p), p);
+            parseIRStream( state, &p, end, lineNumber, &finished, &code->repeat.a, &code->repeat.b );
+            break;
+
+        default: /* line end, should be no more data */
+            while ( p < end && isspace(*p) )
+                { ++p; }
+
+            if ( p < end )
+                logError("spurious characters \"%.*s\" at end of line %d", (int)(end - p), p, lineNumber);
+
+            finished = 1;
+            break;
+        }
+        ++fieldNumber;
+
+    } while (!finished);
+}
+
+int readLines( FILE *  file, tImportState *state )
+{
+    int     lineNumber;
+    char    line[1024];
+    size_t  length;
+    unsigned long long bytes = 0;
+
+    initScanner();
 
     lineNumber = 1;
     do {
@@ -254,137 +466,235 @@ int importDB( FILE *  file )
             if (ferror(file))
             {
                 logDebugErrno(0, "error reading file");
+                countBytesRead(bytes);
                 return (-3);
             }
         }
         else 
         {
-            p = line;
-            fieldNumber = 0;
-            finished = 0;
-            
-            do {
-                switch (fieldNumber)
-                {
-                case 0:
-                    while (*p != '\0' && isspace(*p))
-                        { ++p; }
-
-                    if ( *p == '\0' || *p == '#' || *p == ';')
-                        finished = 1;
-
-                    logDebug(2, "line start: %s", p);
-                    break;
-
-                case 1: /* code set ID */
-                    number = parseNumber(&p, lineNumber, &finished);
-                    logDebug(2, "code set ID: %ld", number);
-
-                    /* take care of the code set */
-                    if (codeSet == NULL || codeSet->id != number)
-                    {
-                        if (codeSet == NULL)
-                        {
-                            gIRCodeSets = calloc(1, sizeof(tIRCodeSet));
-                            codeSet = gIRCodeSets;
-                        }
-                        else
-                        {
-                            codeSet->next = calloc(1, sizeof(tIRCodeSet));
-                            codeSet = codeSet->next;
-                        }
-                        codeSet->id = number;
-                        /* look up the brand and device type */
-                        /* linear lookup, rather inefficient... */
-                        i = 0;
-                        while ( gCodesetMapping[i].id != 0 )
-                        {
-                            if (gCodesetMapping[i].id == number)
-                            {
-                                codeSet->deviceType = gCodesetMapping[i].deviceType;
-                                codeSet->brand      = gCodesetMapping[i].brand;
-                                break;
-                            }
-                            ++i;
-                        }
-                        if (gCodesetMapping[i].id == 0)
-                            logWarning("Codeset %lu has no mapping information on line %d", number, lineNumber);
-                    }
-
-                    /* allocate a new IRCode */
-                    if (gIRCodes == NULL)
-                    {
-                        gIRCodes = calloc(1, sizeof(tIRCode));
-                        code = gIRCodes;
-                    }
-                    else
-                    {
-                        code->nextA = calloc(1, sizeof(tIRCode));
-                        code = code->nextA;
-                    }
-
-                    if (code != NULL)
-                    {
-                        /* point the new IRCode to its parent IRCodeSet */
-                        code->parent = codeSet;
-                        code->lineNumber = lineNumber;
-                        
-                        /* now add it to the chain for this set */
-                        if (codeSet->irCodes == NULL)
-                        { /* first one to be added */
-                            codeSet->irCodes = code;
-                            codeSet->lastIrCode = code;
-                        }
-                        else
-                        { /* append subsequent ones */
-                            codeSet->lastIrCode->next = code;
-                            codeSet->lastIrCode = code;
-                        }
-                    }
-                    break;
-
-                case 2: /* carrier freq */
-                    code->fingerprint.carrierFreq = parseNumber( &p, lineNumber, &finished );
-                    logDebug(2, "carrier freq: %ld", code->fingerprint.carrierFreq);
-                    break;
-
-                case 3: /* repeat behavior */
-                    code->fingerprint.repeatType = parseRepeatype( &p, lineNumber, &finished );
-                    break;
-
-                case 4: /* button label */
-                    code->button.label = parseLabel( &p, lineNumber, &finished );
-                    logDebug(3, "button label: \'%s\'", code->button.label);
-                    break;
-
-                case 5: /* first code */
-                    logDebug(2, "first stream: %s", p);
-                    parseIRStream( &p, lineNumber, &finished, &code->first.a, &code->first.b );
-                    break;
-
-                case 6: /* repeat code */
-                    logDebug(2, "repeat stream: %s", p);
-                    parseIRStream( &p, lineNumber, &finished, &code->repeat.a, &code->repeat.b );
-                    break;
-
-                default: /* line end, should be no more data */
-                    while ( *p != '\0' && isspace(*p) )
-                        { ++p; }
-
-                    if ( *p != '\0' )
-                        logError("spurious characters \"%s\" at end of line %d", p, lineNumber);
-
-                    finished = 1;
-                    break;
-                }
-                ++fieldNumber;
-
-            } while (!finished);
-
+            length = strlen(line);
+            importLine( state, line, line + length, lineNumber );
+            bytes += length;
             ++lineNumber;
         }
 
     } while (!feof(file));
 
+    countBytesRead(bytes);
     return (0);
 }
+
+int importDB( FILE *  file, tDBFormat format )
+{
+    tImportState state = { &gStore, &gArena, 1, 0, 0, NULL, NULL };
+    int     result;
+
+    if (format == kBinaryFormat)
+        return importBinaryDB( file );
+
+    result = readLines( file, &state );
+    clearStreamTable( &state.streams );
+
+    return result;
+}
+
+/*
+    Rather than building the whole database, pass each code set to 'completed'
+    as soon as the last of its lines has been read, then release it. Relies on
+    the lines for each code set being contiguous in the input. Everything for
+    the code set (including analysis results) must be allocated from gArena.
+*/
+int importStreamDB( FILE *  file, tCodeSetHandler completed, void *context )
+{
+    tImportState state = { &gStore, &gArena, 1, 0, 0, NULL, NULL };
+    int     result;
+
+    state.completed = completed;
+    state.context   = context;
+
+    result = readLines( file, &state );
+
+    if (gStore.codeSetCount > 0)
+        completed( &gStore.codeSets[gStore.codeSetCount - 1], context );
+
+    arenaReset( &gArena );
+    clearStreamTable( &state.streams );
+    resetCodeStore( &gStore );
+
+    return result;
+}
+
+void *countChunkLines( void *arg )
+{
+    tImportChunk *chunk = arg;
+    const char   *p;
+
+    chunk->lineCount = 0;
+    for ( p = chunk->start; (p = memchr( p, '\n', chunk->end - p )) != NULL; ++p )
+        ++chunk->lineCount;
+
+    return NULL;
+}
+
+/* find the code set ID on the last non-comment line before p, for chunks that begin mid-set */
+int precedingCodeSetId( const char *base, const char *p, unsigned long *id )
+{
+    const char  *start;
+
+    while (p > base)
+    {
+        /* back up to the start of the previous line */
+        start = p - 1;
+        while (start > base && start[-1] != '\n')
+            { --start; }
+        p = start;
+
+        while (*start != '\n' && isspace(*start))
+            { ++start; }
+
+        if (isdigit(*start))
+        {
+            *id = 0;
+            while (isdigit(*start))
+                *id = (*id * 10) + (*start++ - '0');
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void *importChunk( void *arg )
+{
+    tImportChunk *chunk = arg;
+    const char   *p, *e;
+    int          lineNumber;
+
+    lineNumber = chunk->firstLine;
+    for ( p = chunk->start; p < chunk->end; p = e )
+    {
+        e = memchr( p, '\n', chunk->end - p );
+        e = (e == NULL) ? chunk->end : e + 1;
+
+        importLine( &chunk->state, p, e, lineNumber );
+        ++lineNumber;
+    }
+    return NULL;
+}
+
+/* run fn over every chunk, one thread per chunk. Runs inline if a thread can't be started. */
+void runChunks( tImportChunk *chunks, int count, void *(*fn)(void *) )
+{
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (i == count - 1 || pthread_create( &chunks[i].thread, NULL, fn, &chunks[i] ) != 0)
+        {
+            chunks[i].thread = pthread_self();
+            fn( &chunks[i] );
+        }
+    }
+    for (i = 0; i < count; ++i)
+    {
+        if ( !pthread_equal( chunks[i].thread, pthread_self() ) )
+            pthread_join( chunks[i].thread, NULL );
+    }
+}
+
+/*
+    Split [base, end) into threadCount chunks at line boundaries, and parse
+    them concurrently. Line numbers are counted up front (also in parallel)
+    so that diagnostics from the parsing threads report the right line.
+*/
+int importChunks( const char *base, const char *end, int threadCount )
+{
+    tImportChunk    *chunks;
+    const char      *p;
+    int             i, lineNumber;
+
+    chunks = calloc( threadCount, sizeof(tImportChunk) );
+    if (chunks == NULL)
+    {
+        logErrorErrno("unable to allocate import chunks");
+        return (-4);
+    }
+
+    p = base;
+    for (i = 0; i < threadCount; ++i)
+    {
+        chunks[i].start = p;
+        if (i == threadCount - 1)
+            p = end;
+        else if (p < base + ((end - base) / threadCount) * (i + 1))
+        {
+            p = base + ((end - base) / threadCount) * (i + 1);
+            p = memchr( p, '\n', end - p );
+            p = (p == NULL) ? end : p + 1;
+        }
+        chunks[i].end = p;
+    }
+
+    if (threadCount > 1)
+        runChunks( chunks, threadCount, countChunkLines );
+
+    lineNumber = 1;
+    for (i = 0; i < threadCount; ++i)
+    {
+        chunks[i].firstLine = lineNumber;
+        chunks[i].state.store = &chunks[i].store;
+        chunks[i].state.arena = &chunks[i].arena;
+        chunks[i].state.copyLabels = 0;
+        chunks[i].state.continues = precedingCodeSetId( base, chunks[i].start, &chunks[i].state.continuedId );
+        lineNumber += chunks[i].lineCount;
+    }
+
+    runChunks( chunks, threadCount, importChunk );
+
+    /* a code set straddling a chunk boundary is merged back together */
+    for (i = 0; i < threadCount; ++i)
+    {
+        appendCodeStore( &gStore, &chunks[i].store );
+        arenaAdopt( &gArena, &chunks[i].arena );
+        clearStreamTable( &chunks[i].state.streams );
+    }
+
+    free(chunks);
+    return (0);
+}
+
+/*
+    Map the whole input file and parse it in place, rather than copying it a
+    line at a time. Labels are left pointing into the mapping, so it is never
+    unmapped. Falls back to importDB() if the input can't be mapped (e.g. a pipe).
+    With a threadCount above one, the mapping is split up and parsed in parallel.
+*/
+int importMappedDB( FILE *  file, int threadCount )
+{
+    struct stat info;
+    const char  *base;
+
+    if ( fstat( fileno(file), &info ) != 0 || !S_ISREG( info.st_mode ) )
+    {
+        logInfo("input is not a regular file, reading it sequentially");
+        return importDB( file, kTextFormat );
+    }
+
+    if ( info.st_size == 0 )
+        return (0);
+
+    base = mmap( NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0 );
+    if ( base == MAP_FAILED )
+    {
+        logWarningErrno("unable to map input file, reading it sequentially");
+        return importDB( file, kTextFormat );
+    }
+    posix_madvise( (void *)base, info.st_size, POSIX_MADV_SEQUENTIAL );
+
+    if (threadCount < 1)
+        threadCount = 1;
+
+    initScanner();
+
+    countBytesRead( info.st_size );
+    return importChunks( base, base + info.st_size, threadCount );
+}
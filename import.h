@@ -4,5 +4,40 @@
     Copyright 2011, Paul Chambers. All Rights Reserved.
 */
 
-int importDB(FILE *inputFile);
+typedef void (*tCodeSetHandler)(tIRCodeSet *codeSet, void *context);
+
+/* hash-consing table - identical streams are only stored once, and shared */
+typedef struct {
+    unsigned long long hash;
+    tIRStream       *stream;    /* NULL if the slot is empty */
+} tStreamSlot;
+
+typedef struct {
+    tStreamSlot     *slot;
+    size_t          size;       /* a power of two, at least twice count */
+    size_t          count;
+} tStreamTable;
+
+/* the store being built while importing */
+typedef struct {
+    tCodeStore  *store;
+    tArena      *arena;         /* where the streams are allocated from */
+    int         copyLabels;     /* zero if labels may point into the input buffer */
+    int         continues;      /* non-zero if the first code set was started before this chunk */
+    unsigned long continuedId;
+    tCodeSetHandler completed;  /* if set, streaming - called as each code set is finished */
+    void        *context;
+    tStreamTable streams;       /* everything in it was allocated from arena */
+} tImportState;
+
+int importDB(FILE *inputFile, tDBFormat format);
+int importMappedDB(FILE *inputFile, int threadCount);
+int importStreamDB(FILE *inputFile, tCodeSetHandler completed, void *context);
+
+tBrand brandFromName(const char *name, size_t length);
+
+/* the parsing itself - also timed on its own by microbench */
+void importLine( tImportState *state, const char *p, const char *end, int lineNumber );
+void parseIRStream( tImportState *state, const char **str, const char *end, int lineNumber, int *error, tIRStream **streamA, tIRStream **streamB );
+void clearStreamTable( tStreamTable *table );
 
@@ -1,19 +1,66 @@
 /*
     @file logging.c
 
+    Messages are formatted by the thread logging them, into a ring buffer
+    of that thread's own, and written out by a thread of their own. Each
+    ring has one writer and one reader, so neither side takes a lock - the
+    logging thread publishes whole messages, and the log thread writes out
+    whatever has been published, a ring at a time. So a message is never
+    split, and the messages between lockLog() and unlockLog() are published
+    together, so they can't be split either. When a ring is full, the
+    thread logging into it waits, or throws the message away and counts it,
+    as set by setLogOverflow().
+
+    If the log thread can't be started, messages are written as they're
+    logged, under a lock.
+
     Copyright 2011, Paul Chambers. All Rights Reserved.
 */
 
-#include <stdlib.h>
-#include <stdio.h>
+#include "common.h"
+
 #include <stdarg.h>
-#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
 
 #include "logging.h"
 
+#define LOG_RING_SIZE       (64 * 1024)     /* per thread - must be a power of two */
+#define LOG_MAX_RINGS       128
+#define LOG_MESSAGE_MAX     4096
+#define LOG_WAKE_LEVEL      (LOG_RING_SIZE / 4) /* wake the log thread once a ring is this full... */
+#define LOG_IDLE_WAIT       20                  /* ...or it wakes itself after this many milliseconds */
+
 int     gLogThreshold = LOG_INFO;
 FILE *  gLogFile      = NULL;
 
+typedef struct {
+    int             owned;      /* a live thread is logging into it */
+    int             held;       /* lockLog() nesting - nothing is published while held */
+    unsigned long   head;       /* where the next byte goes. Only the owner touches it */
+    unsigned long   published;  /* the log thread may write out everything before this... */
+    unsigned long   tail;       /* ...and has written out everything before this */
+    char            data[LOG_RING_SIZE];
+} tLogRing;
+
+static struct {
+    tLogRing        *ring[LOG_MAX_RINGS];
+    int             ringCount;
+    pthread_key_t   key;        /* the calling thread's ring */
+
+    pthread_t       thread;
+    int             running;
+    int             stopping;
+    int             sleeping;
+
+    pthread_mutex_t lock;       /* held by the log thread while it writes. Recursive, for the fallback */
+    pthread_cond_t  wake;
+
+    tLogOverflow    overflow;
+    unsigned long   dropped;
+} gLog;
+
 static const char *msgLevelStr[] = {
     "### Emergency: ",  /*  LOG_EMERG   0   system is unusable */
     "### Alert:   ",    /*  LOG_ALERT   1   action must be taken immediately */
@@ -25,47 +72,411 @@ static const char *msgLevelStr[] = {
     DEBUG_LINE_PREFIX   /*  LOG_DEBUG   7   debug-level messages */
 };
 
-/* this will be necessary when syslog logging is added */
+static void pauseLogging(void)
+{
+    sched_yield();
+}
+
+static void wakeLogThread(void)
+{
+    if ( __atomic_load_n( &gLog.sleeping, __ATOMIC_SEQ_CST ) )
+    {
+        pthread_mutex_lock( &gLog.lock );
+        pthread_cond_signal( &gLog.wake );
+        pthread_mutex_unlock( &gLog.lock );
+    }
+}
+
+/* waking the log thread for every message would cost more than writing it */
+static void publish(tLogRing *ring)
+{
+    __atomic_store_n( &ring->published, ring->head, __ATOMIC_SEQ_CST );
+    if (ring->head - __atomic_load_n( &ring->tail, __ATOMIC_ACQUIRE ) >= LOG_WAKE_LEVEL)
+        wakeLogThread();
+}
+
+/* a thread's ring is handed on to the next thread to start, once it exits */
+static void releaseRing(void *arg)
+{
+    tLogRing    *ring = arg;
+
+    ring->held = 0;
+    publish( ring );
+    __atomic_store_n( &ring->owned, 0, __ATOMIC_RELEASE );
+}
+
+static tLogRing *claimRing(void)
+{
+    tLogRing    *ring;
+    int         i, count, expected;
+
+    for (;;)
+    {
+        count = __atomic_load_n( &gLog.ringCount, __ATOMIC_ACQUIRE );
+        for (i = 0; i < count && i < LOG_MAX_RINGS; ++i)
+        {
+            ring = __atomic_load_n( &gLog.ring[i], __ATOMIC_ACQUIRE );
+            expected = 0;
+            if ( ring != NULL
+              && __atomic_compare_exchange_n( &ring->owned, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) )
+                return ring;
+        }
+
+        if (count < LOG_MAX_RINGS)
+        {
+            i = __atomic_fetch_add( &gLog.ringCount, 1, __ATOMIC_ACQ_REL );
+            if (i < LOG_MAX_RINGS)
+            {
+                ring = calloc( 1, sizeof(tLogRing) );
+                if (ring == NULL)
+                    return NULL;
+
+                ring->owned = 1;
+                __atomic_store_n( &gLog.ring[i], ring, __ATOMIC_RELEASE );
+                return ring;
+            }
+        }
+
+        /* every ring is in use - wait for a thread to finish */
+        pauseLogging();
+    }
+}
+
+static tLogRing *myRing(void)
+{
+    tLogRing    *ring;
+
+    if ( !gLog.running )
+        return NULL;
+
+    ring = pthread_getspecific( gLog.key );
+    if (ring == NULL)
+    {
+        ring = claimRing();
+        if (ring != NULL)
+            pthread_setspecific( gLog.key, ring );
+    }
+    return ring;
+}
+
+static void writeLog(const char *bytes, size_t length)
+{
+    tLogRing        *ring;
+    unsigned long   offset, tail;
+    size_t          first;
+
+    ring = myRing();
+    if (ring == NULL)
+    {
+        pthread_mutex_lock( &gLog.lock );
+        fwrite( bytes, 1, length, gLogFile );
+        pthread_mutex_unlock( &gLog.lock );
+        return;
+    }
+
+    if (length > LOG_RING_SIZE)
+        length = LOG_RING_SIZE;
+
+    while ( LOG_RING_SIZE - (ring->head - (tail = __atomic_load_n( &ring->tail, __ATOMIC_ACQUIRE ))) < length )
+    {
+        /* only what's being held back is left, and it doesn't fit - it can't be kept together */
+        if (tail == ring->published && ring->published != ring->head)
+            publish( ring );
+
+        wakeLogThread();
+        if (gLog.overflow == kLogDrop)
+        {
+            __atomic_fetch_add( &gLog.dropped, 1, __ATOMIC_RELAXED );
+            return;
+        }
+        pauseLogging();
+    }
+
+    offset = ring->head & (LOG_RING_SIZE - 1);
+    first  = LOG_RING_SIZE - offset;
+    if (first > length)
+        first = length;
+
+    memcpy( &ring->data[offset], bytes, first );
+    memcpy( ring->data, bytes + first, length - first );
+    ring->head += length;
+
+    if ( !ring->held )
+        publish( ring );
+}
+
+static void writeAll( int fd, const char *bytes, size_t length )
+{
+    ssize_t written;
+
+    while (length > 0)
+    {
+        written = write( fd, bytes, length );
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        bytes  += written;
+        length -= written;
+    }
+}
+
+/* writes out everything published in every ring. Returns the number of bytes written */
+static size_t drainRings(void)
+{
+    tLogRing        *ring;
+    unsigned long   published, tail, offset;
+    size_t          length, first, total = 0;
+    int             i, count;
+
+    count = __atomic_load_n( &gLog.ringCount, __ATOMIC_ACQUIRE );
+    for (i = 0; i < count && i < LOG_MAX_RINGS; ++i)
+    {
+        ring = __atomic_load_n( &gLog.ring[i], __ATOMIC_ACQUIRE );
+        if (ring == NULL)
+            continue;
+
+        published = __atomic_load_n( &ring->published, __ATOMIC_SEQ_CST );
+        tail      = ring->tail;
+        if (published == tail)
+            continue;
+
+        length = published - tail;
+        offset = tail & (LOG_RING_SIZE - 1);
+        first  = LOG_RING_SIZE - offset;
+        if (first > length)
+            first = length;
+
+        writeAll( fileno(gLogFile), &ring->data[offset], first );
+        if (length > first)
+            writeAll( fileno(gLogFile), ring->data, length - first );
+
+        __atomic_store_n( &ring->tail, published, __ATOMIC_RELEASE );
+        total += length;
+    }
+    return total;
+}
+
+static void *logThread( void *UNUSED(arg) )
+{
+    struct timeval  now;
+    struct timespec until;
+
+    pthread_mutex_lock( &gLog.lock );
+    for (;;)
+    {
+        if ( drainRings() > 0 )
+            continue;
+
+        if ( __atomic_load_n( &gLog.stopping, __ATOMIC_SEQ_CST ) )
+            break;
+
+        /*
+            look again after saying we're asleep. Anything that needs us
+            sooner than the timeout can't wake us until we're waiting, as
+            we hold the lock until then.
+        */
+        __atomic_store_n( &gLog.sleeping, 1, __ATOMIC_SEQ_CST );
+        if ( drainRings() == 0 && !__atomic_load_n( &gLog.stopping, __ATOMIC_SEQ_CST ) )
+        {
+            gettimeofday( &now, NULL );
+            until.tv_sec  = now.tv_sec;
+            until.tv_nsec = (now.tv_usec + LOG_IDLE_WAIT * 1000L) * 1000L;
+            if (until.tv_nsec >= 1000000000L)
+            {
+                until.tv_sec  += 1;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait( &gLog.wake, &gLog.lock, &until );
+        }
+        __atomic_store_n( &gLog.sleeping, 0, __ATOMIC_SEQ_CST );
+    }
+    pthread_mutex_unlock( &gLog.lock );
+
+    return NULL;
+}
+
+/* waits until everything logged so far has been written out */
+void flushLog(void)
+{
+    tLogRing    *ring;
+    int         i, count;
+
+    if ( !gLog.running )
+    {
+        if (gLogFile != NULL)
+            fflush( gLogFile );
+        return;
+    }
+
+    ring = pthread_getspecific( gLog.key );
+    if (ring != NULL && ring->published != ring->head)
+        publish( ring );
+
+    count = __atomic_load_n( &gLog.ringCount, __ATOMIC_ACQUIRE );
+    for (i = 0; i < count && i < LOG_MAX_RINGS; ++i)
+    {
+        ring = __atomic_load_n( &gLog.ring[i], __ATOMIC_ACQUIRE );
+        while ( ring != NULL
+             && __atomic_load_n( &ring->tail, __ATOMIC_ACQUIRE ) != __atomic_load_n( &ring->published, __ATOMIC_ACQUIRE ) )
+        {
+            wakeLogThread();
+            pauseLogging();
+        }
+    }
+
+    /* the log thread holds the lock until it's flushed and gone back to sleep */
+    pthread_mutex_lock( &gLog.lock );
+    fflush( gLogFile );
+    pthread_mutex_unlock( &gLog.lock );
+}
+
+static void shutdownLogging(void)
+{
+    unsigned long   dropped;
+
+    if ( !gLog.running )
+        return;
+
+    flushLog();
+
+    __atomic_store_n( &gLog.stopping, 1, __ATOMIC_SEQ_CST );
+    pthread_mutex_lock( &gLog.lock );
+    pthread_cond_signal( &gLog.wake );
+    pthread_mutex_unlock( &gLog.lock );
+    pthread_join( gLog.thread, NULL );
+    gLog.running = 0;
+
+    dropped = __atomic_load_n( &gLog.dropped, __ATOMIC_RELAXED );
+    if (dropped != 0 && gLogFile != NULL)
+    {
+        fprintf( gLogFile, "%s%lu log messages were dropped\n", msgLevelStr[LOG_WARNING], dropped );
+        fflush( gLogFile );
+    }
+}
+
 void initLogging(int logLevel, FILE *logFile)
 {
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init( &attr );
+    pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+    pthread_mutex_init( &gLog.lock, &attr );
+    pthread_mutexattr_destroy( &attr );
+    pthread_cond_init( &gLog.wake, NULL );
+
     setLogThreshold( logLevel );
     logTo( logFile );
+
+    gLog.overflow = kLogBlock;
+    if ( pthread_key_create( &gLog.key, releaseRing ) == 0 )
+    {
+        gLog.running = 1;
+        if ( pthread_create( &gLog.thread, NULL, logThread, NULL ) == 0 )
+            atexit( shutdownLogging );
+        else
+            gLog.running = 0;   /* write each message as it's logged */
+    }
 }
 
 void setLogThreshold(int logLevel)
 {
     gLogThreshold = logLevel;
+
+#ifdef LOG_COMPILE_FLOOR_SET
+    if (logLevel > LOG_COMPILE_FLOOR)
+        logWarning("messages above level %d were compiled out of this build", LOG_COMPILE_FLOOR);
+#endif
+}
+
+void setLogOverflow(tLogOverflow overflow)
+{
+    gLog.overflow = overflow;
+}
+
+void lockLog(void)
+{
+    tLogRing    *ring;
+
+    ring = myRing();
+    if (ring != NULL)
+        ++ring->held;
+    else pthread_mutex_lock( &gLog.lock );
+}
+
+void unlockLog(void)
+{
+    tLogRing    *ring;
+
+    ring = myRing();
+    if (ring == NULL)
+        pthread_mutex_unlock( &gLog.lock );
+    else if (--ring->held == 0)
+        publish( ring );
 }
 
 void logTo(FILE *logFile)
 {
+    flushLog();
+
+    pthread_mutex_lock( &gLog.lock );
     if (gLogFile != NULL && gLogFile != stderr)
         fclose(gLogFile);
 
     gLogFile = logFile;
+    pthread_mutex_unlock( &gLog.lock );
 }
 
 void _logHelper( int level, const char *file, const char * UNUSED(function), const int line, const int error, const char *format, ...)
 {
+    char    message[LOG_MESSAGE_MAX];
     va_list args;
-    int msgLevel;
-    
+    int     msgLevel, length;
+
     if (gLogFile != NULL)
     {
         va_start(args, format);
-     
+
         msgLevel = level;
         if (msgLevel > LOG_DEBUG)
             msgLevel = LOG_DEBUG;
-        
-        fprintf(gLogFile, "%s%s, line %d: ", msgLevelStr[msgLevel], file, line);
 
-        vfprintf(gLogFile, format, args);
+        /* leave room for the newline */
+        length = snprintf(message, sizeof(message) - 1, "%s%s, line %d: ", msgLevelStr[msgLevel], file, line);
 
-        if (error != 0)
-            fprintf(gLogFile, " (%d: %s)", error, strerror(error));
+        if (length < (int)sizeof(message) - 1)
+            length += vsnprintf(message + length, sizeof(message) - 1 - length, format, args);
+
+        if (error != 0 && length < (int)sizeof(message) - 1)
+            length += snprintf(message + length, sizeof(message) - 1 - length, " (%d: %s)", error, strerror(error));
 
-        fputc('\n', gLogFile);
+        if (length > (int)sizeof(message) - 2)
+            length = sizeof(message) - 2;
+        message[length++] = '\n';
+
+        writeLog(message, length);
+
+        va_end(args);
+    }
+}
+
+void _logPrintf( const char *format, ...)
+{
+    char    message[LOG_MESSAGE_MAX];
+    va_list args;
+    int     length;
+
+    if (gLogFile != NULL)
+    {
+        va_start(args, format);
+
+        length = vsnprintf(message, sizeof(message), format, args);
+        if (length > (int)sizeof(message) - 1)
+            length = sizeof(message) - 1;
+        if (length > 0)
+            writeLog(message, length);
 
         va_end(args);
     }
@@ -74,11 +485,14 @@ void _logHelper( int level, const char *file, const char * UNUSED(function), con
 void _fatalExit( int exitcode, const char *file, const char * UNUSED(function), const int line, const int error, const char *format, ...)
 {
     va_list args;
-    
+
     if (gLogFile != NULL)
     {
+        /* so it comes after everything logged before it */
+        flushLog();
+
         va_start(args, format);
-     
+
         fprintf(stderr, "%s%s, line %d: ", msgLevelStr[LOG_CRIT], file, line);
         vfprintf(stderr, format, args);
 
@@ -91,4 +505,4 @@ void _fatalExit( int exitcode, const char *file, const char * UNUSED(function),
     }
 
     exit(exitcode);
-}   
+}
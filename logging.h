@@ -27,10 +27,36 @@ extern int gLogThreshold;
 /* also private - set using logTo() */
 extern FILE *gLogFile;
 
+/* what a thread does when its messages are being logged faster than they can be written */
+typedef enum {
+    kLogBlock,      /* wait for the log to catch up */
+    kLogDrop        /* throw the message away, and count it */
+} tLogOverflow;
+
 void initLogging(int logLevel, FILE *logFile);
 void setLogThreshold(int logLevel);
+void setLogOverflow(tLogOverflow overflow);
 void logTo(FILE *logFile);
 
+/* messages are written out on a thread of their own - waits until it has caught up */
+void flushLog(void);
+
+/* keeps other threads' messages out of a multi-line dump */
+void lockLog(void);
+void unlockLog(void);
+
+/*
+    Anything less important than LOG_COMPILE_FLOOR is compiled out. The
+    test is a constant, so the call goes, and its arguments are never
+    evaluated. Fatal messages and errors are always compiled in.
+*/
+#ifdef LOG_COMPILE_FLOOR
+#define LOG_COMPILE_FLOOR_SET   /* by the build, so some messages may really be missing */
+#else
+#define LOG_COMPILE_FLOOR       (LOG_DEBUG + 99)
+#endif
+#define logCompiledIn(level)    ((level) <= LOG_COMPILE_FLOOR)
+
 /* loggging macros */
 
 #define logFatal(...) \
@@ -44,26 +70,29 @@ void logTo(FILE *logFile);
             { _logHelper(LOG_ERR, __FILE__, __func__, __LINE__, errno, __VA_ARGS__); }
 
 #define logWarning(...) \
-            { if (LOG_WARNING <= gLogThreshold) _logHelper(LOG_WARNING, __FILE__, __func__, __LINE__, 0, __VA_ARGS__); }
+            { if (logCompiledIn(LOG_WARNING) && LOG_WARNING <= gLogThreshold) _logHelper(LOG_WARNING, __FILE__, __func__, __LINE__, 0, __VA_ARGS__); }
 #define logWarningErrno(...) \
-            { if (LOG_WARNING <= gLogThreshold) _logHelper(LOG_WARNING, __FILE__, __func__, __LINE__, errno, __VA_ARGS__); }
+            { if (logCompiledIn(LOG_WARNING) && LOG_WARNING <= gLogThreshold) _logHelper(LOG_WARNING, __FILE__, __func__, __LINE__, errno, __VA_ARGS__); }
 
 #define logInfo(...) \
-            { if (LOG_INFO <= gLogThreshold) _logHelper(LOG_INFO, __FILE__, __func__, __LINE__, 0, __VA_ARGS__); }
+            { if (logCompiledIn(LOG_INFO) && LOG_INFO <= gLogThreshold) _logHelper(LOG_INFO, __FILE__, __func__, __LINE__, 0, __VA_ARGS__); }
 #define logInfoErrno(...) \
-            { if (LOG_INFO <= gLogThreshold) _logHelper(LOG_INFO, __FILE__, __func__, __LINE__, errno, __VA_ARGS__); }
+            { if (logCompiledIn(LOG_INFO) && LOG_INFO <= gLogThreshold) _logHelper(LOG_INFO, __FILE__, __func__, __LINE__, errno, __VA_ARGS__); }
 
 #define logDebug(level, ...) \
-            { if ((LOG_DEBUG + level) <= gLogThreshold) _logHelper((LOG_DEBUG + level), __FILE__, __func__, __LINE__, 0, __VA_ARGS__); }
+            { if (logCompiledIn(LOG_DEBUG + level) && (LOG_DEBUG + level) <= gLogThreshold) _logHelper((LOG_DEBUG + level), __FILE__, __func__, __LINE__, 0, __VA_ARGS__); }
 #define logDebugErrno(level, ...) \
-            { if ((LOG_DEBUG + level) <= gLogThreshold) _logHelper((LOG_DEBUG + level), __FILE__, __func__, __LINE__, errno, __VA_ARGS__); }
+            { if (logCompiledIn(LOG_DEBUG + level) && (LOG_DEBUG + level) <= gLogThreshold) _logHelper((LOG_DEBUG + level), __FILE__, __func__, __LINE__, errno, __VA_ARGS__); }
 
 void _logHelper( int level, const char *file, const char *function, const int line, const int error, const char *format, ...)
         __attribute__ ((format (printf, 6, 7)));
 
 #define DEBUG_LINE_PREFIX   "dbg: "
-#define logDebugEnabled(level)  ((LOG_DEBUG + level) <= gLogThreshold)
-#define logprintf(...)          { fprintf(gLogFile, __VA_ARGS__); }
+#define logDebugEnabled(level)  (logCompiledIn(LOG_DEBUG + level) && (LOG_DEBUG + level) <= gLogThreshold)
+#define logprintf(...)          { _logPrintf(__VA_ARGS__); }
+
+void _logPrintf( const char *format, ...)
+        __attribute__ ((format (printf, 1, 2)));
 
 /* fatal error macros */
 
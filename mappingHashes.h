@@ -0,0 +1,492 @@
+/* automatically generated by generateMappings - DO NOT EDIT! */
+
+#define CODESET_HASH_BUCKETS 78
+#define CODESET_HASH_SLOTS   312
+
+static const unsigned int gCodesetDisplacement[78] = {
+    102, 2, 357, 93, 3, 3, 1, 2, 4, 27, 12, 1,
+    5, 3, 251, 40, 2, 17, 54, 155, 30, 4, 99, 0,
+    51, 2, 98, 177, 19, 120, 5, 397, 3, 72, 153, 17,
+    16, 1, 154, 77, 272, 237, 88, 25, 348, 36, 2, 133,
+    14, 8, 100, 118, 92, 4, 675, 29, 0, 554, 1377, 19,
+    94, 34, 58, 1198, 39, 995, 566, 1, 60, 0, 245, 4131,
+    255, 0, 174, 46, 130, 287,
+};
+
+static const struct {
+    unsigned int id;
+    tDeviceType deviceType;
+    tBrand brand;
+} gCodesetSlot[312] = {
+    { 100047, kTelevision, kBrandElementElectronics },
+    { 200023, kSetTopBox, kBrandSony },
+    { 400074, kAVReceiver, kBrandYamaha },
+    { 200020, kSetTopBox, kBrandRCA },
+    { 100080, kTelevision, kBrandPhilips },
+    { 400042, kAVReceiver, kBrandRotel },
+    { 400015, kAVReceiver, kBrandAcousticResearch },
+    { 400068, kAVReceiver, kBrandZenith },
+    { 300006, kDvdPlayer, kBrandOppo },
+    { 400005, kAVReceiver, kBrandInsignia },
+    { 200012, kSetTopBox, kBrandCisco },
+    { 400046, kAVReceiver, kBrandKoss },
+    { 200035, kSetTopBox, kBrandPicoMacom },
+    { 300030, kDvdPlayer, kBrandDynex },
+    { 100012, kTelevision, kBrandLG },
+    { 300053, kDvdPlayer, kBrandApex },
+    { 300056, kDvdPlayer, kBrandGateway },
+    { 300054, kDvdPlayer, kBrandAudiovox },
+    { 300031, kDvdPlayer, kBrandAllegro },
+    { 100085, kTelevision, kBrandZenith },
+    { 400077, kAVReceiver, kBrandHarmanKardon },
+    { 100068, kTelevision, kBrandBenQ },
+    { 100038, kTelevision, kBrandEmerson },
+    { 100035, kTelevision, kBrandViore },
+    { 400031, kAVReceiver, kBrandJVC },
+    { 400065, kAVReceiver, kBrandPyle },
+    { 200014, kSetTopBox, kBrandDish },
+    { 100096, kTelevision, kBrandLoewe },
+    { 300098, kDvdPlayer, kBrandProScan },
+    { 300075, kDvdPlayer, kBrandInsignia },
+    { 100072, kTelevision, kBrandAdmiral },
+    { 100052, kTelevision, kBrandSceptre },
+    { 400008, kAVReceiver, kBrandiLive },
+    { 100092, kTelevision, kBrandElectrohome },
+    { 100003, kTelevision, kBrandVizio },
+    { 100023, kTelevision, kBrandSharp },
+    { 100089, kTelevision, kBrandPanasonic },
+    { 200029, kSetTopBox, kBrandPanasonic },
+    { 400030, kAVReceiver, kBrandJensen },
+    { 400049, kAVReceiver, kBrandOptimus },
+    { 300086, kDvdPlayer, kBrandPanasonic },
+    { 100041, kTelevision, kBrandRCA },
+    { 300089, kDvdPlayer, kBrandSharp },
+    { 300027, kDvdPlayer, kBrandSansui },
+    { 300084, kDvdPlayer, kBrandPhilips },
+    { 400081, kAVReceiver, kBrandMitsubishi },
+    { 100029, kTelevision, kBrandApex },
+    { 400027, kAVReceiver, kBrandLuxman },
+    { 400032, kAVReceiver, kBrandFisher },
+    { 400038, kAVReceiver, kBrandOnkyo },
+    { 300077, kDvdPlayer, kBrandMitsubishi },
+    { 100002, kTelevision, kBrandSony },
+    { 300083, kDvdPlayer, kBrandToshiba },
+    { 300106, kDvdPlayer, kBrandTruTech },
+    { 300024, kDvdPlayer, kBrandGoVideo },
+    { 400054, kAVReceiver, kBrandTeac },
+    { 400037, kAVReceiver, kBrandNikko },
+    { 300099, kDvdPlayer, kBrandPhilips },
+    { 300035, kDvdPlayer, kBrandHarmanKardon },
+    { 300015, kDvdPlayer, kBrandLexicon },
+    { 400016, kAVReceiver, kBrandDenon },
+    { 300055, kDvdPlayer, kBrandBenQ },
+    { 400028, kAVReceiver, kBrandMarantz },
+    { 300044, kDvdPlayer, kBrandPhilips },
+    { 300092, kDvdPlayer, kBrandTeac },
+    { 200027, kSetTopBox, kBrandPhilips },
+    { 200032, kSetTopBox, kBrandBellExpressVu },
+    { 200034, kSetTopBox, kBrandHitachi },
+    { 100086, kTelevision, kBrandWestinghouse },
+    { 300079, kDvdPlayer, kBrandMagnavox },
+    { 300046, kDvdPlayer, kBrandMarantz },
+    { 100058, kTelevision, kBrandAudiovox },
+    { 400017, kAVReceiver, kBrandJBL },
+    { 100048, kTelevision, kBrandHannspree },
+    { 400070, kAVReceiver, kBrandCurtisMathes },
+    { 100021, kTelevision, kBrandCasio },
+    { 400041, kAVReceiver, kBrandRCA },
+    { 300105, kDvdPlayer, kBrandOritron },
+    { 100093, kTelevision, kBrandDaewoo },
+    { 100016, kTelevision, kBrandOptoma },
+    { 100074, kTelevision, kBrandAkai },
+    { 300036, kDvdPlayer, kBrandVizio },
+    { 300102, kDvdPlayer, kBrandDaewoo },
+    { 400036, kAVReceiver, kBrandNEC },
+    { 100088, kTelevision, kBrandSymphonic },
+    { 400035, kAVReceiver, kBrandNakamichi },
+    { 400019, kAVReceiver, kBrandPhilips },
+    { 400083, kAVReceiver, kBrandMagnavox },
+    { 300037, kDvdPlayer, kBrandSyntax },
+    { 300060, kDvdPlayer, kBrandKenwood },
+    { 100070, kTelevision, kBrandWestinghouse },
+    { 300034, kDvdPlayer, kBrandCoby },
+    { 100059, kTelevision, kBrandAdmiral },
+    { 300051, kDvdPlayer, kBrandAdmiral },
+    { 100076, kTelevision, kBrandHitachi },
+    { 100030, kTelevision, kBrandHaier },
+    { 300020, kDvdPlayer, kBrandJwin },
+    { 100045, kTelevision, kBrandSharp },
+    { 300078, kDvdPlayer, kBrandNEC },
+    { 200026, kSetTopBox, kBrandLG },
+    { 400010, kAVReceiver, kBrandSamsung },
+    { 400064, kAVReceiver, kBrandYamaha },
+    { 300072, kDvdPlayer, kBrandHarmanKardon },
+    { 400059, kAVReceiver, kBrandAiwa },
+    { 400066, kAVReceiver, kBrandSherwood },
+    { 400026, kAVReceiver, kBrandHitachi },
+    { 400082, kAVReceiver, kBrandPhilips },
+    { 100043, kTelevision, kBrandToshiba },
+    { 300108, kDvdPlayer, kBrandRSQ },
+    { 100071, kTelevision, kBrandJVC },
+    { 300065, kDvdPlayer, kBrandApex },
+    { 300076, kDvdPlayer, kBrandLG },
+    { 400018, kAVReceiver, kBrandRCA },
+    { 300032, kDvdPlayer, kBrandTeac },
+    { 200013, kSetTopBox, kBrandMoxi },
+    { 200024, kSetTopBox, kBrandAurora },
+    { 300080, kDvdPlayer, kBrandAccurian },
+    { 100025, kTelevision, kBrandJVC },
+    { 300023, kDvdPlayer, kBrandCaliforniaAudioLabs },
+    { 200028, kSetTopBox, kBrandCanalPlus },
+    { 200017, kSetTopBox, kBrandMagnavox },
+    { 400023, kAVReceiver, kBrandPanasonic },
+    { 200030, kSetTopBox, kBrandToshiba },
+    { 300048, kDvdPlayer, kBrandAkai },
+    { 100090, kTelevision, kBrandYamaha },
+    { 100044, kTelevision, kBrandSansui },
+    { 100019, kTelevision, kBrandSunBrite },
+    { 100011, kTelevision, kBrandPanasonic },
+    { 100066, kTelevision, kBrandTCL },
+    { 300007, kDvdPlayer, kBrandMemorex },
+    { 300013, kDvdPlayer, kBrandSharp },
+    { 100013, kTelevision, kBrandMitsubishi },
+    { 400085, kAVReceiver, kBrandYamaha },
+    { 400021, kAVReceiver, kBrandKenwood },
+    { 300025, kDvdPlayer, kBrandEmerson },
+    { 300040, kDvdPlayer, kBrandSherwood },
+    { 300038, kDvdPlayer, kBrandHewlettPackard },
+    { 300090, kDvdPlayer, kBrandSensoryScience },
+    { 100053, kTelevision, kBrandNexus },
+    { 200016, kSetTopBox, kBrandInsignia },
+    { 300045, kDvdPlayer, kBrandMagnavox },
+    { 400067, kAVReceiver, kBrandToshiba },
+    { 100015, kTelevision, kBrandOptoma },
+    { 100017, kTelevision, kBrandOptoma },
+    { 100079, kTelevision, kBrandILO },
+    { 100031, kTelevision, kBrandProScan },
+    { 300001, kDvdPlayer, kBrandSony },
+    { 100032, kTelevision, kBrandVizio },
+    { 100026, kTelevision, kBrandSharp },
+    { 300017, kDvdPlayer, kBrandRCA },
+    { 300002, kDvdPlayer, kBrandSamsung },
+    { 400045, kAVReceiver, kBrandSharp },
+    { 300028, kDvdPlayer, kBrandHitachi },
+    { 100049, kTelevision, kBrandHitachi },
+    { 100006, kTelevision, kBrandInsignia },
+    { 200003, kSetTopBox, kBrandComcastMotorola },
+    { 300067, kDvdPlayer, kBrandCoby },
+    { 100078, kTelevision, kBrandVisionQuest },
+    { 100014, kTelevision, kBrandMitsubishi },
+    { 200022, kSetTopBox, kBrandSonicview },
+    { 100036, kTelevision, kBrandHaier },
+    { 300059, kDvdPlayer, kBrandNakamichi },
+    { 100073, kTelevision, kBrandViore },
+    { 200021, kSetTopBox, kBrandNFusion },
+    { 400003, kAVReceiver, kBrandTeac },
+    { 300063, kDvdPlayer, kBrandFaroudja },
+    { 300073, kDvdPlayer, kBrandHitachi },
+    { 300016, kDvdPlayer, kBrandCurtisMathes },
+    { 400069, kAVReceiver, kBrandKlipsch },
+    { 300004, kDvdPlayer, kBrandInsignia },
+    { 100056, kTelevision, kBrandDell },
+    { 400011, kAVReceiver, kBrandJVC },
+    { 200036, kSetTopBox, kBrandPansat },
+    { 400080, kAVReceiver, kBrandMcIntosh },
+    { 300003, kDvdPlayer, kBrandPanasonic },
+    { 100024, kTelevision, kBrandMemorex },
+    { 100083, kTelevision, kBrandFunai },
+    { 300100, kDvdPlayer, kBrandProtron },
+    { 400022, kAVReceiver, kBrandKrell },
+    { 100004, kTelevision, kBrandPanasonic },
+    { 100061, kTelevision, kBrandFujitsu },
+    { 100008, kTelevision, kBrandSony },
+    { 400058, kAVReceiver, kBrandAdcom },
+    { 100022, kTelevision, kBrandEpson },
+    { 300010, kDvdPlayer, kBrandLG },
+    { 300058, kDvdPlayer, kBrandFisher },
+    { 100094, kTelevision, kBrandBellAndHowell },
+    { 400079, kAVReceiver, kBrandMarantz },
+    { 400002, kAVReceiver, kBrandHarmanKardon },
+    { 100077, kTelevision, kBrandFluid },
+    { 100001, kTelevision, kBrandSylvania },
+    { 300107, kDvdPlayer, kBrandPhilips },
+    { 300071, kDvdPlayer, kBrandGoVideo },
+    { 400012, kAVReceiver, kBrandSony },
+    { 400053, kAVReceiver, kBrandSoundesign },
+    { 100065, kTelevision, kBrandPolaroid },
+    { 300064, kDvdPlayer, kBrandAkai },
+    { 300109, kDvdPlayer, kBrandMagnavox },
+    { 300022, kDvdPlayer, kBrandArrgo },
+    { 100046, kTelevision, kBrandMitsubishi },
+    { 200008, kSetTopBox, kBrandZenith },
+    { 300088, kDvdPlayer, kBrandSamsung },
+    { 100082, kTelevision, kBrandPioneer },
+    { 400076, kAVReceiver, kBrandHarmanKardon },
+    { 100028, kTelevision, kBrandVivitek },
+    { 400048, kAVReceiver, kBrandNAD },
+    { 300042, kDvdPlayer, kBrandNAD },
+    { 300103, kDvdPlayer, kBrandDurabrand },
+    { 100007, kTelevision, kBrandDynex },
+    { 300097, kDvdPlayer, kBrandFaroudja },
+    { 100039, kTelevision, kBrandHitachi },
+    { 400001, kAVReceiver, kBrandSharp },
+    { 300110, kDvdPlayer, kBrandSylvania },
+    { 200001, kSetTopBox, kBrandTivo },
+    { 400062, kAVReceiver, kBrandDenon },
+    { 300026, kDvdPlayer, kBrandAudiovox },
+    { 300009, kDvdPlayer, kBrandJVC },
+    { 300052, kDvdPlayer, kBrandAiwa },
+    { 400072, kAVReceiver, kBrandYamaha },
+    { 200025, kSetTopBox, kBrandJVC },
+    { 400020, kAVReceiver, kBrandBose },
+    { 400043, kAVReceiver, kBrandSansui },
+    { 300011, kDvdPlayer, kBrandOnkyo },
+    { 400033, kAVReceiver, kBrandPanasonic },
+    { 100087, kTelevision, kBrandWestinghouse },
+    { 300081, kDvdPlayer, kBrandHaier },
+    { 200011, kSetTopBox, kBrandPace },
+    { 400013, kAVReceiver, kBrandPanasonic },
+    { 300104, kDvdPlayer, kBrandKonka },
+    { 300101, kDvdPlayer, kBrandAMW },
+    { 400014, kAVReceiver, kBrandSony },
+    { 400057, kAVReceiver, kBrandLexicon },
+    { 200010, kSetTopBox, kBrandSlingMedia },
+    { 100060, kTelevision, kBrandBroksonic },
+    { 300074, kDvdPlayer, kBrandJVC },
+    { 300021, kDvdPlayer, kBrand3DLab },
+    { 300091, kDvdPlayer, kBrandSylvania },
+    { 300062, kDvdPlayer, kBrandJensen },
+    { 300082, kDvdPlayer, kBrandSony },
+    { 400052, kAVReceiver, kBrandTechnics },
+    { 100054, kTelevision, kBrandAOC },
+    { 200031, kSetTopBox, kBrandHughes },
+    { 400084, kAVReceiver, kBrandYamaha },
+    { 400029, kAVReceiver, kBrandMagnavox },
+    { 100057, kTelevision, kBrandGateway },
+    { 400034, kAVReceiver, kBrandAiwa },
+    { 300085, kDvdPlayer, kBrandPhilips },
+    { 300012, kDvdPlayer, kBrandSylvania },
+    { 300066, kDvdPlayer, kBrandCitizen },
+    { 300043, kDvdPlayer, kBrandINOi },
+    { 100099, kTelevision, kBrandMagnavox },
+    { 200033, kSetTopBox, kBrandFujitsu },
+    { 100062, kTelevision, kBrandCurtisMathes },
+    { 100069, kTelevision, kBrandAstar },
+    { 300057, kDvdPlayer, kBrandILO },
+    { 300094, kDvdPlayer, kBrandToshiba },
+    { 300041, kDvdPlayer, kBrandCoby },
+    { 300096, kDvdPlayer, kBrandDenon },
+    { 100020, kTelevision, kBrandInsignia },
+    { 300047, kDvdPlayer, kBrandFunai },
+    { 400078, kAVReceiver, kBrandHarmanKardon },
+    { 300068, kDvdPlayer, kBrandEmerson },
+    { 400040, kAVReceiver, kBrandPioneer },
+    { 300061, kDvdPlayer, kBrandRotel },
+    { 300005, kDvdPlayer, kBrandYamaha },
+    { 300069, kDvdPlayer, kBrandFisher },
+    { 400009, kAVReceiver, kBrandYamaha },
+    { 100075, kTelevision, kBrandBellAndHowell },
+    { 100084, kTelevision, kBrandZenith },
+    { 300070, kDvdPlayer, kBrandFunai },
+    { 400025, kAVReceiver, kBrandCarver },
+    { 200004, kSetTopBox, kBrandPace },
+    { 400024, kAVReceiver, kBrandCarver },
+    { 300008, kDvdPlayer, kBrandDenon },
+    { 400055, kAVReceiver, kBrandFosgate },
+    { 300019, kDvdPlayer, kBrandAccurian },
+    { 400004, kAVReceiver, kBrandOnkyo },
+    { 100063, kTelevision, kBrandMemorex },
+    { 400051, kAVReceiver, kBrandSony },
+    { 300087, kDvdPlayer, kBrandRCA },
+    { 300050, kDvdPlayer, kBrandAcousticResearch },
+    { 300033, kDvdPlayer, kBrandPioneer },
+    { 100055, kTelevision, kBrandHewlettPackard },
+    { 300018, kDvdPlayer, kBrandCyberHome },
+    { 300014, kDvdPlayer, kBrandSensoryScience },
+    { 400039, kAVReceiver, kBrandPanasonic },
+    { 100005, kTelevision, kBrandSamsung },
+    { 100037, kTelevision, kBrandCurtisMathes },
+    { 300093, kDvdPlayer, kBrandYamaha },
+    { 200019, kSetTopBox, kBrandSabrent },
+    { 400006, kAVReceiver, kBrandPioneer },
+    { 100064, kTelevision, kBrandHyundai },
+    { 400047, kAVReceiver, kBrandMcIntosh },
+    { 100033, kTelevision, kBrandVizio },
+    { 400061, kAVReceiver, kBrandParasound },
+    { 100018, kTelevision, kBrandSharp },
+    { 100040, kTelevision, kBrandSanyo },
+    { 300049, kDvdPlayer, kBrandMitsubishi },
+    { 400071, kAVReceiver, kBrandLG },
+    { 200037, kSetTopBox, kBrandATT },
+    { 300039, kDvdPlayer, kBrandHewlettPackard },
+    { 200005, kSetTopBox, kBrandDish },
+    { 400063, kAVReceiver, kBrandSanyo },
+    { 400007, kAVReceiver, kBrandCoby },
+    { 100091, kTelevision, kBrandGeneralElectric },
+    { 400060, kAVReceiver, kBrandAudioAccess },
+    { 100042, kTelevision, kBrandSony },
+    { 200015, kSetTopBox, kBrandDigitalStream },
+    { 300095, kDvdPlayer, kBrandSony },
+    { 400056, kAVReceiver, kBrandLexicon },
+    { 400044, kAVReceiver, kBrandScott },
+    { 200009, kSetTopBox, kBrandRadioShack },
+};
+
+#define BRAND_HASH_BUCKETS 36
+#define BRAND_HASH_SLOTS   144
+
+static const unsigned int gBrandDisplacement[36] = {
+    170, 6, 14, 4, 266, 21, 1, 152, 18, 223, 3, 28,
+    1, 1, 25, 3, 68, 1, 19, 45, 99, 26, 408, 61,
+    476, 87, 526, 23, 1, 15, 1358, 2916, 648, 632, 3204, 2,
+};
+
+static const struct {
+    const char *name;
+    tBrand brand;
+} gBrandSlot[144] = {
+    { "Apex", kBrandApex },
+    { "Rotel", kBrandRotel },
+    { "Technics", kBrandTechnics },
+    { "RSQ", kBrandRSQ },
+    { "ATT", kBrandATT },
+    { "AOC", kBrandAOC },
+    { "Pico Macom", kBrandPicoMacom },
+    { "Sherwood", kBrandSherwood },
+    { "Panasonic", kBrandPanasonic },
+    { "Parasound", kBrandParasound },
+    { "Audiovox", kBrandAudiovox },
+    { "Sharp", kBrandSharp },
+    { "Nakamichi", kBrandNakamichi },
+    { "Sanyo", kBrandSanyo },
+    { "Symphonic", kBrandSymphonic },
+    { "Zenith", kBrandZenith },
+    { "Haier", kBrandHaier },
+    { "Onkyo", kBrandOnkyo },
+    { "Fluid", kBrandFluid },
+    { "Oppo", kBrandOppo },
+    { "Scientific Atlanta", kBrandScientificAtlanta },
+    { "Viore", kBrandViore },
+    { "Kenwood", kBrandKenwood },
+    { "ProScan", kBrandProScan },
+    { "Westinghouse", kBrandWestinghouse },
+    { "Protron", kBrandProtron },
+    { "iLive", kBrandiLive },
+    { "JVC", kBrandJVC },
+    { "TruTech", kBrandTruTech },
+    { "Bell & Howell", kBrandBellAndHowell },
+    { "Marantz", kBrandMarantz },
+    { "Jensen", kBrandJensen },
+    { "NEC", kBrandNEC },
+    { "Hannspree", kBrandHannspree },
+    { "Pace", kBrandPace },
+    { "Loewe", kBrandLoewe },
+    { "Vizio", kBrandVizio },
+    { "General Electric", kBrandGeneralElectric },
+    { "Gateway", kBrandGateway },
+    { "Orion", kBrandOrion },
+    { "Teac", kBrandTeac },
+    { "McIntosh", kBrandMcIntosh },
+    { "Akai", kBrandAkai },
+    { "Polaroid", kBrandPolaroid },
+    { "Optoma", kBrandOptoma },
+    { "Daewoo", kBrandDaewoo },
+    { "Aiwa", kBrandAiwa },
+    { "Dynex", kBrandDynex },
+    { "Electrohome", kBrandElectrohome },
+    { "Coby", kBrandCoby },
+    { "Syntax", kBrandSyntax },
+    { "Nikko", kBrandNikko },
+    { "Sonicview", kBrandSonicview },
+    { "CanalPlus", kBrandCanalPlus },
+    { "NAD", kBrandNAD },
+    { "Hughes", kBrandHughes },
+    { "Hewlett Packard", kBrandHewlettPackard },
+    { "Nexus", kBrandNexus },
+    { "NFusion", kBrandNFusion },
+    { "Faroudja", kBrandFaroudja },
+    { "Hyundai", kBrandHyundai },
+    { "Vivitek", kBrandVivitek },
+    { "Acoustic Research", kBrandAcousticResearch },
+    { "RCA", kBrandRCA },
+    { "Luxman", kBrandLuxman },
+    { "Philips", kBrandPhilips },
+    { "Casio", kBrandCasio },
+    { "Curtis", kBrandCurtis },
+    { "Dish", kBrandDish },
+    { "Pyle", kBrandPyle },
+    { "Lexicon", kBrandLexicon },
+    { "Pansat", kBrandPansat },
+    { "Allegro", kBrandAllegro },
+    { "Vision Quest", kBrandVisionQuest },
+    { "DISH", kBrandDISH },
+    { "Fujitsu", kBrandFujitsu },
+    { "LG", kBrandLG },
+    { "Fisher", kBrandFisher },
+    { "Cisco", kBrandCisco },
+    { "Yamaha", kBrandYamaha },
+    { "GoVideo", kBrandGoVideo },
+    { "Jwin", kBrandJwin },
+    { "Brand", kBrandBrand },
+    { "Tristar", kBrandTristar },
+    { "Mitsubishi", kBrandMitsubishi },
+    { "Element Electronics", kBrandElementElectronics },
+    { "Sabrent", kBrandSabrent },
+    { "Adcom", kBrandAdcom },
+    { "Toshiba", kBrandToshiba },
+    { "Sylvania", kBrandSylvania },
+    { "Bose", kBrandBose },
+    { "Hitachi", kBrandHitachi },
+    { "Moxi", kBrandMoxi },
+    { "RadioShack", kBrandRadioShack },
+    { "SunBrite", kBrandSunBrite },
+    { "Dell", kBrandDell },
+    { "Sling Media", kBrandSlingMedia },
+    { "Aurora", kBrandAurora },
+    { "Magnavox", kBrandMagnavox },
+    { "BenQ", kBrandBenQ },
+    { "Klipsch", kBrandKlipsch },
+    { "Admiral", kBrandAdmiral },
+    { "Astar", kBrandAstar },
+    { "Optimus", kBrandOptimus },
+    { "Funai", kBrandFunai },
+    { "Pioneer", kBrandPioneer },
+    { "Broksonic", kBrandBroksonic },
+    { "AMW", kBrandAMW },
+    { "Carver", kBrandCarver },
+    { "Fosgate", kBrandFosgate },
+    { "California Audio Labs", kBrandCaliforniaAudioLabs },
+    { "Koss", kBrandKoss },
+    { "Harman Kardon", kBrandHarmanKardon },
+    { "Soundesign", kBrandSoundesign },
+    { "Memorex", kBrandMemorex },
+    { "Sansui", kBrandSansui },
+    { "Audio Access", kBrandAudioAccess },
+    { "Insignia", kBrandInsignia },
+    { "Samsung", kBrandSamsung },
+    { "Oritron", kBrandOritron },
+    { "CyberHome", kBrandCyberHome },
+    { "3D Lab", kBrand3DLab },
+    { "Digital Stream", kBrandDigitalStream },
+    { "Durabrand", kBrandDurabrand },
+    { "Denon", kBrandDenon },
+    { "Accurian", kBrandAccurian },
+    { "Emerson", kBrandEmerson },
+    { "Comcast/Motorola", kBrandComcastMotorola },
+    { "Konka", kBrandKonka },
+    { "JBL", kBrandJBL },
+    { "INOi", kBrandINOi },
+    { "Sony", kBrandSony },
+    { "Scott", kBrandScott },
+    { "TCL", kBrandTCL },
+    { "Epson", kBrandEpson },
+    { "Curtis Mathes", kBrandCurtisMathes },
+    { "Krell", kBrandKrell },
+    { "Citizen", kBrandCitizen },
+    { "Bell ExpressVu", kBrandBellExpressVu },
+    { "Tivo", kBrandTivo },
+    { "ILO", kBrandILO },
+    { "Sceptre", kBrandSceptre },
+    { "Sensory Science", kBrandSensoryScience },
+    { "Arrgo", kBrandArrgo },
+};
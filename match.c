@@ -0,0 +1,159 @@
+/*
+    @file match.c
+
+    Fuzzy matching kernels for the analysis. A value v matches reference r
+    within a threshold t (in tenths of a percent) when
+
+        2000 * |r - v| / (r + v) < t
+
+    and solving that for v gives the band r(2000-t)/(2000+t) < v <
+    r(2000+t)/(2000-t), with the ends rounded exactly as the integer
+    division rounds them.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include "match.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MATCH_X86   1
+#include <immintrin.h>
+#endif
+
+tFuzzyBand fuzzyBand(unsigned long reference, unsigned int threshold)
+{
+    tFuzzyBand band;
+
+    band.reference = reference;
+    if (reference == 0)
+    {
+        band.lo = 0;
+        band.hi = 0;
+    }
+    else
+    {
+        band.lo = (reference * (2000 - threshold)) / (2000 + threshold) + 1;
+        band.hi = (reference * (2000 + threshold) - 1) / (2000 - threshold);
+    }
+    return band;
+}
+
+void referenceBands(const unsigned int *refhist, unsigned int threshold, tFuzzyBand *band)
+{
+    int i;
+
+    for (i = 0; i < REFERENCE_BANDS && refhist[i] != 0; ++i)
+        band[i] = fuzzyBand(refhist[i], threshold);
+
+    for ( ; i < REFERENCE_BANDS; ++i)
+    {
+        band[i].lo = 1;
+        band[i].hi = 0;
+        band[i].reference = 0;
+    }
+}
+
+static unsigned long snapPeriodsScalar(unsigned long *period, size_t count,
+                                       const tFuzzyBand *mark, const tFuzzyBand *space,
+                                       unsigned char *matched)
+{
+    const tFuzzyBand *band;
+    unsigned long sum = 0;
+    size_t  i;
+    int     k;
+
+    for (i = 0; i < count; ++i)
+    {
+        band = (i & 1) ? space : mark;
+        for (k = 0; k < REFERENCE_BANDS; ++k)
+        {
+            if ( inFuzzyBand(&band[k], period[i]) )
+            {
+                period[i] = band[k].reference;
+                break;
+            }
+        }
+        matched[i] = k;
+        sum += period[i];
+    }
+    return sum;
+}
+
+#ifdef MATCH_X86
+
+/*
+    Four periods at a time. The lanes alternate mark, space, mark, space
+    just as the periods do, so each band is loaded once for the whole
+    stream. Periods and bands are well under 2^63, so the signed compares
+    are safe. The sum wraps just as adding the periods one by one does.
+*/
+__attribute__((target("avx2")))
+static unsigned long snapPeriodsAVX2(unsigned long *period, size_t count,
+                                     const tFuzzyBand *mark, const tFuzzyBand *space,
+                                     unsigned char *matched)
+{
+    __m256i lo[REFERENCE_BANDS], hi[REFERENCE_BANDS], reference[REFERENCE_BANDS];
+    __m256i v, snapped, index, outside, sum;
+    unsigned long long lanes[4];
+    size_t  i;
+    int     k;
+
+    for (k = 0; k < REFERENCE_BANDS; ++k)
+    {
+        lo[k] = _mm256_set_epi64x( space[k].lo, mark[k].lo, space[k].lo, mark[k].lo );
+        hi[k] = _mm256_set_epi64x( space[k].hi, mark[k].hi, space[k].hi, mark[k].hi );
+        reference[k] = _mm256_set_epi64x( space[k].reference, mark[k].reference,
+                                          space[k].reference, mark[k].reference );
+    }
+
+    sum = _mm256_setzero_si256();
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        v = _mm256_loadu_si256((const __m256i *)&period[i]);
+        snapped = v;
+        index = _mm256_set1_epi64x(REFERENCE_BANDS);
+
+        /* last to first, so the first band that matches is the one left */
+        for (k = REFERENCE_BANDS - 1; k >= 0; --k)
+        {
+            outside = _mm256_or_si256( _mm256_cmpgt_epi64(lo[k], v), _mm256_cmpgt_epi64(v, hi[k]) );
+            snapped = _mm256_blendv_epi8( reference[k], snapped, outside );
+            index   = _mm256_blendv_epi8( _mm256_set1_epi64x(k), index, outside );
+        }
+
+        _mm256_storeu_si256((__m256i *)&period[i], snapped);
+        sum = _mm256_add_epi64( sum, snapped );
+
+        _mm256_storeu_si256((__m256i *)lanes, index);
+        matched[i]     = lanes[0];
+        matched[i + 1] = lanes[1];
+        matched[i + 2] = lanes[2];
+        matched[i + 3] = lanes[3];
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, sum);
+
+    /* i is a multiple of four, so what's left still starts with a mark */
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+         + snapPeriodsScalar(&period[i], count - i, mark, space, &matched[i]);
+}
+
+#endif /* MATCH_X86 */
+
+unsigned long (*snapPeriods)(unsigned long *period, size_t count,
+                             const tFuzzyBand *mark, const tFuzzyBand *space,
+                             unsigned char *matched) = snapPeriodsScalar;
+
+void initMatcher(void)
+{
+#ifdef MATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        logDebug(1, "using AVX2 matcher");
+        snapPeriods = snapPeriodsAVX2;
+    }
+#endif
+}
@@ -0,0 +1,44 @@
+/*
+    @file match.h
+
+    Fuzzy matching of periods against references. A reference and a
+    tolerance are turned into the band of values that match it once, so
+    each test is then two compares rather than a division.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+/* one per entry in a tReferenceHistogram */
+#define REFERENCE_BANDS 4
+
+typedef struct {
+    unsigned long   lo, hi;     /* inclusive - nothing matches if lo > hi */
+    unsigned long   reference;
+} tFuzzyBand;
+
+/*
+    the values v that fuzzyMatch(reference, v, threshold) accepts. A zero
+    reference only matches zero, as durationsMatch() has it.
+*/
+tFuzzyBand fuzzyBand(unsigned long reference, unsigned int threshold);
+
+/* one band per entry, up to the first zero entry. The rest match nothing */
+void referenceBands(const unsigned int *refhist, unsigned int threshold, tFuzzyBand *band);
+
+static inline int inFuzzyBand(const tFuzzyBand *band, unsigned long value)
+{
+    return (band->lo <= value && value <= band->hi);
+}
+
+/* pick the fastest implementation for this CPU - call before matching */
+void initMatcher(void);
+
+/*
+    Periods alternate mark, space, mark... starting with a mark. Each is
+    replaced by the reference of the first of its bands it falls in, and
+    matched[] gets the index of that band - or REFERENCE_BANDS, leaving the
+    period as it was. Returns the sum of the periods afterwards.
+*/
+extern unsigned long (*snapPeriods)(unsigned long *period, size_t count,
+                                    const tFuzzyBand *mark, const tFuzzyBand *space,
+                                    unsigned char *matched);
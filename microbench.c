@@ -0,0 +1,343 @@
+/*
+    @file microbench.c
+
+    times the analysis kernels on their own, so a change to one of them can
+    be measured without the noise of a whole run. Each kernel is run on a
+    representative code from each protocol family, in batches long enough
+    for the clock to be accurate, and the median and 99th percentile of the
+    batches are reported, after some warmup batches that aren't counted.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+#include "analyse-ir-codes.h"
+
+#include "import.h"
+#include "analyse.h"
+#include "export.h"
+#include "store.h"
+#include "stats.h"
+
+tGlobals globals = {
+    NULL,
+    "0.1",
+    { "", "" },
+    0
+};
+
+tCodeStore  gStore       = CODE_STORE_INITIALIZER;
+tArena      gArena       = ARENA_INITIALIZER;
+
+/* one line per protocol family, as generateCorpus writes them */
+typedef struct {
+    const char      *name;
+    const char      *line;
+
+    /* filled in by setupFamily() */
+    size_t          code;               /* in gStore */
+    const char      *field;             /* the first irstream, in line */
+    tIRStream       *stream;            /* parsed from it */
+    tFingerprint    fingerprint;        /* of the stream, before adjustment */
+    tPeriod         period[2][MAX_RAW_IR_COUNT];   /* marks and spaces, as analyzeIRStream() sees them */
+    size_t          periods[2];
+    tRawHistogram   histogram[2];
+} tFamily;
+
+tFamily gFamily[] = {
+    { "NEC",        "100006|38300|Full_Repeat|Power|345,173,21,64,21,65,21,21,21,65,21,21,21,65,21,21,21,21,21,21,21,63,21,21,21,64,21,64,21,64,21,21,21,65,21,21,21,21,21,65,21,64,21,65,21,21,21,64,21,21,21,64,21,21,21,21,21,64,21,65,21,21,21,64,21,21,21,1523|344,87,21,3618|" },
+    { "Sony",       "100013|40000|Partial_Repeat|Power|96,24,47,24,24,24,49,25,24,24,24,24,47,24,48,25,24,24,24,24,48,24,24,24,24,24,48,24,24,24,24,24,47,24,47,24,24,24,24,24,47,529||" },
+    { "Panasonic",  "100001|37000|Full_Repeat|Power|128,63,16,16,16,47,16,48,16,16,16,16,16,48,16,16,16,47,16,16,16,16,16,48,16,16,16,16,16,48,16,16,16,48,16,16,16,47,16,16,16,48,16,16,16,47,16,16,16,48,16,48,16,16,16,16,16,16,16,16,16,47,16,16,16,47,16,47,16,48,16,47,16,48,16,48,16,47,16,16,16,48,16,48,16,16,16,48,16,48,17,48,16,48,16,16,16,16,16,2059||" },
+    { "RC-5",       "100008|36000|Toggle|Power|63,32,32,65,31,33,64,32,32,32,32,65,63,65,64,32,31,33,32,3645^65,64,32,33,31,32,64,32,32,32,32,64,64,65,64,32,32,32,32,3650||" },
+    { "RC-6",       "100012|37000|Toggle|Power|97,15,33,31,33,15,17,30,17,15,33,31,17,15,33,15,17,30,17,15,33,30,34,30,17,15,17,31,51,15,17,31,33,15,17,15,17,15,17,32,33,31,33,15,17,31,17,15,17,15,17,15,17,15,17,15,17,2543^97,15,33,15,17,15,17,15,17,31,17,15,33,31,17,15,34,15,17,31,17,15,33,31,33,31,17,15,17,31,51,15,17,31,33,15,17,15,17,15,17,31,33,31,33,15,17,31,17,15,17,15,17,15,17,15,17,15,17,2573||" },
+    { "PPM",        "200021|40100|Repeat|Power|21,161,21,202,21,163,21,163,21,162,21,204,21,18,22,18,21,160,21,201,21,202,21,203,21,18,21,198,21,162,21,4559||" },
+    { "unknown",    "100002|37000|Full_Repeat|Last|443,214,487,272,352,191,395,498,485,418,407,256,65,456,62,54,213,149,241,414,430,152,394,239,228,57,1257||" },
+    { NULL }
+};
+
+/* the arena the kernels allocate from - reset before each batch */
+tArena          gBenchArena = ARENA_INITIALIZER;
+tImportState    gImport = { &gStore, &gArena, 1, 0, 0, NULL, NULL };
+FILE            *gNull;
+
+/* results go here, so the calls can't be optimized away */
+volatile unsigned long gSink;
+
+typedef struct {
+    const char      *name;
+    void            (*prepare)(tFamily *family);    /* before each batch, not timed. May be NULL */
+    unsigned long   (*run)(tFamily *family);        /* returns the number of operations done */
+} tKernel;
+
+void resetBenchArena(tFamily * UNUSED(family))
+{
+    arenaReset(&gBenchArena);
+}
+
+/* the parse alone - with nowhere to put the streams, they're not interned */
+unsigned long runParseIRStream(tFamily *family)
+{
+    const char  *p = family->field;
+    int         error = 0;
+
+    parseIRStream(&gImport, &p, p + strlen(p), 1, &error, NULL, NULL);
+    gSink += error + (p - family->field);
+    return 1;
+}
+
+/* each period against the one before, as normalizeRawHistogram() does. Per comparison */
+unsigned long runFuzzyMatch(tFamily *family)
+{
+    tCount  i;
+    int     matched = 0;
+
+    for (i = 1; i < family->stream->count; ++i)
+        matched += fuzzyMatch(family->stream->period[i - 1], family->stream->period[i], MATCH_TOLERANCE);
+
+    gSink += matched;
+    return family->stream->count - 1;
+}
+
+/* sorts in place, so works on a copy */
+unsigned long runBuildRawHistogram(tFamily *family)
+{
+    tPeriod         work[MAX_RAW_IR_COUNT], scratch[MAX_RAW_IR_COUNT];
+    tRawHistogram   histogram;
+    int             i;
+
+    for (i = 0; i < 2; ++i)
+    {
+        memcpy(work, family->period[i], family->periods[i] * sizeof(tPeriod));
+        buildRawHistogram(&histogram, work, scratch, family->periods[i]);
+        gSink += histogram.count;
+    }
+    return 1;
+}
+
+unsigned long runNormalizeRawHistogram(tFamily *family)
+{
+    gSink += (unsigned long)normalizeRawHistogram(&gBenchArena, &family->histogram[0]);
+    gSink += (unsigned long)normalizeRawHistogram(&gBenchArena, &family->histogram[1]);
+    return 1;
+}
+
+unsigned long runAnalyzeIRStream(tFamily *family)
+{
+    tFingerprint fingerprint = gStore.codes[family->code].fingerprint;
+
+    analyzeIRStream(&gBenchArena, family->stream, &fingerprint);
+    gSink += fingerprint.symbolCount;
+    return 1;
+}
+
+unsigned long runIdentifyProtocol(tFamily *family)
+{
+    gSink += (unsigned long)identifyProtocol(&family->fingerprint);
+    return 1;
+}
+
+/* adjusts in place, so works on a copy. Not run for codes that aren't identified */
+unsigned long runAdjustIRStream(tFamily *family)
+{
+    tRawIRStream    work;
+    unsigned int    missed = 0;
+
+    if (family->fingerprint.protocol == NULL)
+        return 0;
+
+    work.count = family->stream->count;
+    memcpy(work.period, family->stream->period, work.count * sizeof(unsigned long));
+    adjustIRStream((tIRStream *)&work, &family->fingerprint, family->fingerprint.protocol, &missed);
+    gSink += missed + work.period[0];
+    return 1;
+}
+
+/* exportIRStream() is private to export.c - this is the smallest exported unit, a one-code set */
+unsigned long runExportIRCodeSet(tFamily *family)
+{
+    exportIRCodeSet(gNull, &gStore.codeSets[ gStore.codes[family->code].codeSet ]);
+    return 1;
+}
+
+tKernel gKernel[] = {
+    { "parseIRStream",          NULL,               runParseIRStream },
+    { "fuzzyMatch",             NULL,               runFuzzyMatch },
+    { "buildRawHistogram",      NULL,               runBuildRawHistogram },
+    { "normalizeRawHistogram",  resetBenchArena,    runNormalizeRawHistogram },
+    { "analyzeIRStream",        resetBenchArena,    runAnalyzeIRStream },
+    { "identifyProtocol",       NULL,               runIdentifyProtocol },
+    { "adjustIRStream",         NULL,               runAdjustIRStream },
+    { "exportIRCodeSet",        NULL,               runExportIRCodeSet },
+    { NULL }
+};
+
+/* import the family's line, and work out what the kernels need from it, as the analysis would */
+void setupFamily(tFamily *family)
+{
+    const char  *p;
+    tCount      i, last;
+    tPeriod     work[MAX_RAW_IR_COUNT], scratch[MAX_RAW_IR_COUNT];
+    int         fields;
+
+    importLine(&gImport, family->line, family->line + strlen(family->line), 1);
+    family->code   = gStore.codeCount - 1;
+    family->stream = gStore.codes[family->code].first.a;
+
+    /* the label may hold a '|' - the stream starts at the first one followed by a digit after it */
+    p = family->line;
+    for (fields = 0; fields < 3; ++p)
+    {
+        if (*p == '|')
+            ++fields;
+    }
+    while ( !(p[0] == '|' && isdigit(p[1])) )
+        ++p;
+    family->field = p + 1;
+
+    family->fingerprint = gStore.codes[family->code].fingerprint;
+    analyzeIRStream(&gArena, family->stream, &family->fingerprint);
+    family->fingerprint.protocol = identifyProtocol(&family->fingerprint);
+
+    /* the same split of the 'meat' of the stream as analyzeIRStream() makes */
+    family->periods[0] = family->periods[1] = 0;
+    last = family->stream->count - 2;
+    for (i = 2; i < last; ++i)
+        family->period[i & 1][ family->periods[i & 1]++ ] = toPeriod(family->stream->period[i]);
+
+    for (i = 0; i < 2; ++i)
+    {
+        memcpy(work, family->period[i], family->periods[i] * sizeof(tPeriod));
+        buildRawHistogram(&family->histogram[i], work, scratch, family->periods[i]);
+    }
+}
+
+/* microseconds for 'batch' calls, and the operations they did */
+unsigned long long timeBatch(tKernel *kernel, tFamily *family, unsigned long batch, unsigned long *ops)
+{
+    unsigned long long start;
+    unsigned long   i;
+
+    if (kernel->prepare != NULL)
+        kernel->prepare(family);
+
+    *ops = 0;
+    start = statsClock();
+    for (i = 0; i < batch; ++i)
+        *ops += kernel->run(family);
+
+    return statsClock() - start;
+}
+
+int compareTimes(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+void benchmark(tKernel *kernel, tFamily *family, int warmup, int repetitions, unsigned long batchMicros)
+{
+    unsigned long   batch, ops;
+    double          *nanos;
+    int             i;
+
+    /* double the batch until it takes long enough to time accurately */
+    batch = 1;
+    while (timeBatch(kernel, family, batch, &ops) < batchMicros && ops > 0)
+        batch *= 2;
+
+    if (ops == 0)
+        return;     /* nothing to do for this family */
+
+    for (i = 0; i < warmup; ++i)
+        timeBatch(kernel, family, batch, &ops);
+
+    nanos = malloc(repetitions * sizeof(double));
+    if (nanos == NULL)
+        fatalExit(-4, "unable to allocate the timings");
+
+    for (i = 0; i < repetitions; ++i)
+        nanos[i] = timeBatch(kernel, family, batch, &ops) * 1000.0 / ops;
+
+    qsort(nanos, repetitions, sizeof(double), compareTimes);
+
+    printf("%-22s %-10s %10.1f %10.1f %10.1f %10lu\n",
+            kernel->name, family->name,
+            nanos[0], nanos[repetitions / 2], nanos[(repetitions * 99 + 99) / 100 - 1],
+            batch);
+    fflush(stdout);
+
+    free(nanos);
+}
+
+void usage(const char *myName)
+{
+    fprintf(stderr,
+"Usage: %s [options]\n"
+"    -k <name>    only the kernels whose names contain <name>\n"
+"    -f <name>    only the protocol families whose names contain <name>\n"
+"    -r <count>   timed batches per kernel and family (default 100)\n"
+"    -w <count>   warmup batches, not timed (default 10)\n"
+"    -t <usecs>   the least time a batch should take (default 1000)\n",
+            myName);
+    exit(-1);
+}
+
+int main(int argc, const char *argv[])
+{
+    const char  *kernelName = "", *familyName = "";
+    int         warmup = 10, repetitions = 100, i;
+    unsigned long batchMicros = 1000;
+    tKernel     *kernel;
+    tFamily     *family;
+
+    initLogging(LOG_WARNING, stderr);
+    globals.myName = argv[0];
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 >= argc)
+            usage(argv[0]);
+
+        switch (argv[i][1])
+        {
+        case 'k': kernelName  = argv[++i]; break;
+        case 'f': familyName  = argv[++i]; break;
+        case 'r': repetitions = atoi(argv[++i]); break;
+        case 'w': warmup      = atoi(argv[++i]); break;
+        case 't': batchMicros = strtoul(argv[++i], NULL, 10); break;
+        default:  usage(argv[0]); break;
+        }
+    }
+    if (repetitions < 1)
+        repetitions = 1;
+
+    gNull = fopen("/dev/null", "w");
+    if (gNull == NULL)
+        fatalExitErrno(-3, "unable to open /dev/null");
+
+    buildProtocolIndex();
+    for (family = gFamily; family->name != NULL; ++family)
+        setupFamily(family);
+
+    printf("%-22s %-10s %10s %10s %10s %10s\n", "kernel", "family", "min ns", "median ns", "p99 ns", "batch");
+    for (kernel = gKernel; kernel->name != NULL; ++kernel)
+    {
+        if (strstr(kernel->name, kernelName) == NULL)
+            continue;
+
+        for (family = gFamily; family->name != NULL; ++family)
+        {
+            if (strstr(family->name, familyName) != NULL)
+                benchmark(kernel, family, warmup, repetitions, batchMicros);
+        }
+    }
+
+    fclose(gNull);
+    clearStreamTable(&gImport.streams);
+    releaseCodeStore(&gStore);
+    arenaRelease(&gArena);
+    arenaRelease(&gBenchArena);
+
+    exit(0);
+}
@@ -0,0 +1,38 @@
+/* macro substitution is used to define matching static arrays using this file */
+/* encoding, symbolCounts, carrierFreq, leading {mark, space}, durations, mark symbols, space symbols */
+defineProtocol( kFromSpec,  "NEC",             kSpaceVaries,       {32},           38000, {342,171}, 4104, {21},     {21,64}, kNECRepeatStream )
+defineProtocol( kFromSpec,  "Sony SIRCS",      kMarkVaries,        {12,15,20},     40000, {96},      1800, {24,48},  {24}     )
+defineProtocol( kFromSpec,  "Philips RC-5",    kBiphase,           {13},           36000, {0},       4445, {32,64},  {32,64}  )
+defineProtocol( kFromSpec,  "Philips RC-5 (a)", kAmbiguous,        {12},           36000, {0},       4445, {32,64},  {32,64}  ) /* RC-5 '0' digit */
+defineProtocol( kFromSpec,  "Philips RC-5e",   kBiphaseExtended,   {18,19},        36000, {0},       4445, {32,64},  {32,64}  )
+defineProtocol( kFromSpec,  "JVC (1)",         kSpaceVaries,       {16,32},        38000, {320,160}, 2195, {20},     {20,60}  )
+defineProtocol( kFromSpec,  "JVC (2)",         kSpaceVaries,       {16,32},        38000, {320,160}, 3373, {20},     {20,60}  )
+/* the following were measured */
+defineProtocol( kMeasured,  "Panasonic",       kSpaceVaries,       {48},           37000, {128,64},  4673, {16},     {16,48}  )
+defineProtocol( kMeasured,  "RCA",             kSpaceVaries,       {24},           57360, {229,229}, 3695, {29},     {57,114} )
+defineProtocol( kMeasured,  "Denon",           kSpaceVaries,       {15},           38000, {0},       2564, {10},     {30,70}  )
+/* the following I created by hand, from analysis of the database */
+defineProtocol( kFromDB,    "NEC-like (1)",    kSpaceVaries,       {32},           38000, {171,171}, 4104, {21},     {21,64}  )
+defineProtocol( kFromDB,    "NEC-Like (2)",    kSpaceVaries,       {32},           38000, {342,171}, 5893, {21},     {21,64}  )
+defineProtocol( kFromDB,    "NEC-Like (3)",    kSpaceVaries,       {28,40,42},     38000, {342,171}, 4104, {21},     {21,64}  )
+defineProtocol( kFromDB,    "Mitsubishi?",     kSpaceVaries,       {16},           33000, {0},       1822, {11},     {28,67}  )
+defineProtocol( kFromDB,    "Mystery2?",       kSpaceVaries,       {10},           36000, {0},        872, {11},     {26,64}  )
+defineProtocol( kFromDB,    "JVC?",            kSpaceVaries,       {16},           58800, {0,360},   3600, {26},     {97,163} )
+defineProtocol( kFromDB,    "Philips? (1)",    kBiphaseExtended,   {37},           37000, {98},      3886, {17,33,50}, {15,31} )
+defineProtocol( kFromDB,    "Philips? (2)",    kBiphase,           {22,23},        38000, {102},     4000, {18,34},  {16,32}  )
+defineProtocol( kFromDB,    "Philips? (3)",    kBiphaseExtended,   {19,20},        38000, {102},     4000, {18,34},  {16,32}  )
+defineProtocol( kFromDB,    "TCL (Philips?)",  kBiphase,           {13},           38400, {0},       4062, {16,32},  {16,32}  )
+defineProtocol( kFromDB,    "Fujitsu?",        kSpaceVaries,       {48},           38400, {132,59},  3904, {20},     {11,44}  ) /* set 100061,200033 */
+defineProtocol( kFromDB,    "Panasonic? (3)",  kSpaceVaries,       {48},           37000, {128,64},  3200, {16},     {16,48}  )
+defineProtocol( kFromDB,    "Panasonic? (4)",  kSpaceVaries,       {22},           56000, {196,196}, 5668, {50},     {45,140} )
+defineProtocol( kFromDB,    "Funai?",          kSpaceVaries,       {24},           38400, {136,136}, 4065, {35},     {31,100} )
+defineProtocol( kFromDB,    "Mystery1?",       kPPM,               {16,21,22},     40000, {0},       7138, {21},     {18,163,203} )
+defineProtocol( kFromDB,    "Pace?",           kSpaceVaries,       {17},           40000, {361},     4000, {23},     {86,178} )     /* set 200011, 200003 */
+defineProtocol( kFromDB,    "Samsung? (2)",    kPPM,               {38},           38400, {172},     4608, {10},     {20,657} )
+defineProtocol( kFromDB,    "Samsung? (1)",    kSpaceVaries,       {48},           38400, {96,71},   3724, {17},     {15,43}  )
+defineProtocol( kFromDB,    "Yamaha?",         kPPM,               {18},           38400, {323},     2550, {23},     {17,53,157} )  /* set 100090,100060,100014 - two part? */
+defineProtocol( kFromDB,    "Mystery3?",       kSpaceVaries,       {11},           48000, {0},       6000, {11},     {239,365} )
+defineProtocol( kFromDB,    "Mystery4?",       kSpaceVaries,       {17},           38400, {94},      4400, {47},     {44,106} )     /* set 200024 */
+defineProtocol( kFromDB,    "Zenith?",         kPPM,               {15},           40000, {0},       7110, {21},     {18,161,201} ) /* set 200008 */
+defineProtocol( kFromDB,    "Mystery5?",       kBiphase,           {11,12,13,14},  38400, {230},     1950, {23,46},  {22,45}  )     /* set 200006 */
+defineProtocol( kFromDB,    "Daewoo?",         kPPM,               {18},           38400, {308},     2291, {20},     {18,56,152} )  /* set 100093 - two part? */
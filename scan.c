@@ -0,0 +1,242 @@
+/*
+    @file scan.c
+
+    Tokenizing kernels for the importer. The irstream fields are long runs
+    of short numbers, so finding where each run of digits ends and turning
+    it into a number a word (or vector) at a time beats doing it a byte at
+    a time.
+
+    None of these read outside [p, end) - the input may be a mapped file,
+    and the page after it need not exist.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include <stdint.h>
+
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86    1
+#include <immintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SCAN_SWAR   1
+#endif
+
+#define ONES        0x0101010101010101ULL
+#define HIGHS       0x8080808080808080ULL
+
+/* high bit set in every byte of v that isn't an ASCII digit */
+static inline uint64_t nonDigitBytes(uint64_t v)
+{
+    uint64_t x = v ^ (ONES * '0');  /* digits become 0..9, nothing else does */
+
+    return ( ((x & (ONES * 0x7F)) + (ONES * (0x80 - 10))) | x ) & HIGHS;
+}
+
+/* high bit set in every byte of v that's equal to c */
+static inline uint64_t matchingBytes(uint64_t v, unsigned char c)
+{
+    uint64_t x = v ^ (ONES * c);
+
+    return ~( ((x & (ONES * 0x7F)) + (ONES * 0x7F)) | x ) & HIGHS;
+}
+
+static const char *scanDigitsSWAR(const char *p, const char *end)
+{
+#ifdef SCAN_SWAR
+    uint64_t v, mask;
+
+    while (p + sizeof(v) <= end)
+    {
+        memcpy(&v, p, sizeof(v));
+        mask = nonDigitBytes(v);
+        if (mask != 0)
+            return p + (__builtin_ctzll(mask) >> 3);
+        p += sizeof(v);
+    }
+#endif
+    while (p < end && isdigit(*p))
+        { ++p; }
+
+    return p;
+}
+
+static const char *scanLabelEndSWAR(const char *p, const char *end)
+{
+#ifdef SCAN_SWAR
+    uint64_t v, mask;
+    const char *e;
+
+    while (p + sizeof(v) <= end)
+    {
+        memcpy(&v, p, sizeof(v));
+        for (mask = matchingBytes(v, '|'); mask != 0; mask &= mask - 1)
+        {
+            e = p + (__builtin_ctzll(mask) >> 3);
+            if (e + 1 < end && isdigit(e[1]))
+                return e;
+        }
+        p += sizeof(v);
+    }
+#endif
+    while ( p < end && ( *p != '|' || p + 1 >= end || !isdigit( p[1] ) ) )
+        { ++p; }
+
+    return p;
+}
+
+#ifdef SCAN_X86
+
+__attribute__((target("sse2")))
+static const char *scanDigitsSSE2(const char *p, const char *end)
+{
+    const __m128i lo = _mm_set1_epi8('0' - 1);
+    const __m128i hi = _mm_set1_epi8('9' + 1);
+    __m128i v;
+    unsigned int mask;
+
+    while (p + sizeof(v) <= end)
+    {
+        v = _mm_loadu_si128((const __m128i *)p);
+        /* bytes >= 0x80 are negative, so fail the first compare */
+        mask = _mm_movemask_epi8( _mm_and_si128( _mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi) ) );
+        mask = ~mask & 0xFFFF;
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += sizeof(v);
+    }
+    return scanDigitsSWAR(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char *scanLabelEndSSE2(const char *p, const char *end)
+{
+    const __m128i bar = _mm_set1_epi8('|');
+    const __m128i lo  = _mm_set1_epi8('0' - 1);
+    const __m128i hi  = _mm_set1_epi8('9' + 1);
+    __m128i v, next;
+    unsigned int mask;
+
+    /* the byte after each candidate comes from a second load, one byte on */
+    while (p + sizeof(v) + 1 <= end)
+    {
+        v    = _mm_loadu_si128((const __m128i *)p);
+        next = _mm_loadu_si128((const __m128i *)(p + 1));
+        mask = _mm_movemask_epi8( _mm_and_si128( _mm_cmpeq_epi8(v, bar),
+                    _mm_and_si128( _mm_cmpgt_epi8(next, lo), _mm_cmplt_epi8(next, hi) ) ) );
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += sizeof(v);
+    }
+    return scanLabelEndSWAR(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *scanDigitsAVX2(const char *p, const char *end)
+{
+    const __m256i lo = _mm256_set1_epi8('0' - 1);
+    const __m256i hi = _mm256_set1_epi8('9' + 1);
+    __m256i v;
+    unsigned int mask;
+
+    while (p + sizeof(v) <= end)
+    {
+        v = _mm256_loadu_si256((const __m256i *)p);
+        mask = _mm256_movemask_epi8( _mm256_and_si256( _mm256_cmpgt_epi8(v, lo), _mm256_cmpgt_epi8(hi, v) ) );
+        mask = ~mask;
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += sizeof(v);
+    }
+    return scanDigitsSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *scanLabelEndAVX2(const char *p, const char *end)
+{
+    const __m256i bar = _mm256_set1_epi8('|');
+    const __m256i lo  = _mm256_set1_epi8('0' - 1);
+    const __m256i hi  = _mm256_set1_epi8('9' + 1);
+    __m256i v, next;
+    unsigned int mask;
+
+    while (p + sizeof(v) + 1 <= end)
+    {
+        v    = _mm256_loadu_si256((const __m256i *)p);
+        next = _mm256_loadu_si256((const __m256i *)(p + 1));
+        mask = _mm256_movemask_epi8( _mm256_and_si256( _mm256_cmpeq_epi8(v, bar),
+                    _mm256_and_si256( _mm256_cmpgt_epi8(next, lo), _mm256_cmpgt_epi8(hi, next) ) ) );
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += sizeof(v);
+    }
+    return scanLabelEndSSE2(p, end);
+}
+
+#endif /* SCAN_X86 */
+
+const char *(*scanDigits)(const char *p, const char *end)   = scanDigitsSWAR;
+const char *(*scanLabelEnd)(const char *p, const char *end) = scanLabelEndSWAR;
+
+void initScanner(void)
+{
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        logDebug(1, "using AVX2 scanner");
+        scanDigits   = scanDigitsAVX2;
+        scanLabelEnd = scanLabelEndAVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        logDebug(1, "using SSE2 scanner");
+        scanDigits   = scanDigitsSSE2;
+        scanLabelEnd = scanLabelEndSSE2;
+    }
+#endif
+}
+
+static const unsigned long powersOfTen[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+/*
+    Converts eight digits at a time: pairs of digits are combined into bytes,
+    pairs of those into 16 bit values, then into one 32 bit value. Unsigned
+    arithmetic is modular, so combining blocks this way overflows exactly
+    as the byte at a time loop would.
+*/
+unsigned long digitsToNumber(const char *p, size_t len)
+{
+    unsigned long number = 0;
+#ifdef SCAN_SWAR
+    uint64_t v;
+    size_t   n;
+
+    while (len > 0)
+    {
+        /* leading block is short - pad it with zero digits in front */
+        n = ((len - 1) & 7) + 1;
+        memset(&v, '0', sizeof(v));
+        memcpy((char *)&v + (8 - n), p, n);
+
+        v = ((v & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+        v = ((v & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+        v = ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+
+        number = (number * powersOfTen[n]) + (unsigned long)v;
+        p   += n;
+        len -= n;
+    }
+#else
+    while (len-- > 0)
+        number = (number * 10) + (*p++ - '0');
+#endif
+    return number;
+}
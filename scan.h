@@ -0,0 +1,20 @@
+/*
+    @file scan.h
+
+    Tokenizing kernels used by the importer. Each has a portable SWAR
+    implementation, and SSE2/AVX2 versions selected at runtime on x86.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+/* pick the fastest implementation for this CPU - call before scanning */
+void initScanner(void);
+
+/* returns the first byte in [p, end) that isn't an ASCII digit, or end */
+extern const char *(*scanDigits)(const char *p, const char *end);
+
+/* returns the first '|' in [p, end) that's followed by a digit, or end */
+extern const char *(*scanLabelEnd)(const char *p, const char *end);
+
+/* value of a run of len ASCII digits - wraps exactly as number*10 + digit does */
+unsigned long digitsToNumber(const char *p, size_t len);
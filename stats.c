@@ -0,0 +1,229 @@
+/*
+    @file stats.c
+
+    Per-phase wall and CPU time, and what went through each phase, reported
+    as JSON. Wall time is gettimeofday(), CPU time is getrusage() for the
+    whole process - so a phase running on several threads can show more
+    CPU than wall time.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include <sys/param.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "analyse-ir-codes.h"
+#include "analyse.h"
+#include "stats.h"
+
+static const char *gPhaseName[kPhaseCount] = { "import", "analysis", "adjustment", "export" };
+
+typedef struct {
+    unsigned long long  wall, cpu;      /* microseconds, accumulated */
+    unsigned long long  startWall, startCPU;
+} tPhaseTime;
+
+static struct {
+    int                 enabled;
+    unsigned long long  startWall;
+    tPhaseTime          phase[kPhaseCount];
+    unsigned long long  bytesRead, bytesWritten;
+    unsigned long long  codeSets, codes, periods;
+} gStats;
+
+static unsigned long long cpuClock(void)
+{
+    struct rusage usage;
+
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        return 0;
+
+    return (unsigned long long)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+         + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+unsigned long long statsClock(void)
+{
+    struct timeval now;
+
+    gettimeofday( &now, NULL );
+    return (unsigned long long)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+void enableStats(void)
+{
+    gStats.enabled = 1;
+    gStats.startWall = statsClock();
+}
+
+int statsEnabled(void)
+{
+    return gStats.enabled;
+}
+
+void startPhase(tPhase phase)
+{
+    if (!gStats.enabled)
+        return;
+
+    gStats.phase[phase].startWall = statsClock();
+    gStats.phase[phase].startCPU  = cpuClock();
+}
+
+void endPhase(tPhase phase)
+{
+    if (!gStats.enabled)
+        return;
+
+    gStats.phase[phase].wall += statsClock() - gStats.phase[phase].startWall;
+    gStats.phase[phase].cpu  += cpuClock()   - gStats.phase[phase].startCPU;
+}
+
+/*
+    The analysis threads time their own adjustments - 'longest' is the
+    busiest thread's total, which is what the wall clock would have seen
+*/
+void countAdjustment(unsigned long long totalMicros, unsigned long long longestMicros)
+{
+    gStats.phase[kAdjustmentPhase].cpu  += totalMicros;
+    gStats.phase[kAdjustmentPhase].wall += longestMicros;
+}
+
+/* may be called from several threads at once */
+void countBytesRead(unsigned long long bytes)
+{
+    if (gStats.enabled)
+        __atomic_fetch_add( &gStats.bytesRead, bytes, __ATOMIC_RELAXED );
+}
+
+void countBytesWritten(unsigned long long bytes)
+{
+    if (gStats.enabled)
+        __atomic_fetch_add( &gStats.bytesWritten, bytes, __ATOMIC_RELAXED );
+}
+
+void countCodeSet(tIRCodeSet *codeSet)
+{
+    tIRCode *code;
+    size_t  i;
+
+    if (!gStats.enabled)
+        return;
+
+    ++gStats.codeSets;
+    gStats.codes += codeSet->codeCount;
+
+    for (i = 0; i < codeSet->codeCount; ++i)
+    {
+        code = &gStore.codes[codeSet->firstCode + i];
+        if (code->first.a  != NULL) gStats.periods += code->first.a->count;
+        if (code->first.b  != NULL) gStats.periods += code->first.b->count;
+        if (code->repeat.a != NULL) gStats.periods += code->repeat.a->count;
+        if (code->repeat.b != NULL) gStats.periods += code->repeat.b->count;
+    }
+}
+
+static void writeString(FILE *file, const char *s)
+{
+    fputc('"', file);
+    for ( ; *s != '\0'; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+            fprintf(file, "\\%c", *s);
+        else if ((unsigned char)*s < ' ')
+            fprintf(file, "\\u%04x", (unsigned char)*s);
+        else
+            fputc(*s, file);
+    }
+    fputc('"', file);
+}
+
+static void writeTime(FILE *file, const char *name, unsigned long long wall, unsigned long long cpu, const char *separator)
+{
+    double seconds = wall / 1000000.0;
+
+    fprintf(file, "    ");
+    writeString(file, name);
+    fprintf(file, ": { \"wall\": %.6f, \"cpu\": %.6f, \"codesPerSecond\": %.0f }%s\n",
+                seconds, cpu / 1000000.0,
+                (seconds > 0) ? gStats.codes / seconds : 0.0,
+                separator);
+}
+
+/* returns zero, or -3 if the file couldn't be written */
+int writeStats(const char *filename, int threadCount)
+{
+    FILE                *file;
+    struct rusage       usage;
+    unsigned long long  wall, cpu, analysisWall, analysisCPU;
+    tPhaseTime          *phase;
+    tReferenceFingerprint *protocol;
+    int                 i, error;
+
+    if (!gStats.enabled)
+        return (0);
+
+    wall = statsClock() - gStats.startWall;
+    cpu  = cpuClock();
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        usage.ru_maxrss = 0;
+
+    file = (strcmp(filename, "-") == 0) ? stdout : fopen(filename, "w");
+    if (file == NULL)
+    {
+        logErrorErrno("unable to open stats file \"%s\"", filename);
+        return (-3);
+    }
+
+    /* the adjustments were made during the analysis phase - don't count them twice */
+    phase = gStats.phase;
+    analysisWall = phase[kAnalysisPhase].wall - MIN(phase[kAnalysisPhase].wall, phase[kAdjustmentPhase].wall);
+    analysisCPU  = phase[kAnalysisPhase].cpu  - MIN(phase[kAnalysisPhase].cpu,  phase[kAdjustmentPhase].cpu);
+
+    fprintf(file, "{\n  \"version\": ");
+    writeString(file, globals.version);
+    fprintf(file, ",\n  \"threads\": %d,\n", threadCount);
+
+    fprintf(file, "  \"phases\": {\n");
+    for (i = 0; i < kPhaseCount; ++i)
+    {
+        if (i == kAnalysisPhase)
+            writeTime(file, gPhaseName[i], analysisWall, analysisCPU, ",");
+        else
+            writeTime(file, gPhaseName[i], phase[i].wall, phase[i].cpu, (i < kPhaseCount - 1) ? "," : "");
+    }
+    fprintf(file, "  },\n");
+
+    fprintf(file, "  \"total\": { \"wall\": %.6f, \"cpu\": %.6f },\n", wall / 1000000.0, cpu / 1000000.0);
+    fprintf(file, "  \"bytesRead\": %llu,\n",    gStats.bytesRead);
+    fprintf(file, "  \"bytesWritten\": %llu,\n", gStats.bytesWritten);
+    fprintf(file, "  \"codeSets\": %llu,\n",     gStats.codeSets);
+    fprintf(file, "  \"codes\": %llu,\n",        gStats.codes);
+    fprintf(file, "  \"periods\": %llu,\n",      gStats.periods);
+    fprintf(file, "  \"codesPerSecond\": %.0f,\n", (wall > 0) ? gStats.codes / (wall / 1000000.0) : 0.0);
+    fprintf(file, "  \"peakRSS\": %llu,\n",      (unsigned long long)usage.ru_maxrss * 1024);    /* ru_maxrss is in KB */
+
+    fprintf(file, "  \"protocols\": {\n");
+    for (protocol = &gProtocol[0]; protocol->confidence != kListEnd; ++protocol)
+    {
+        fprintf(file, "    ");
+        writeString(file, protocol->name);
+        fprintf(file, ": %d,\n", protocol->matched);
+    }
+    /* the list terminator counts the codes that weren't identified */
+    fprintf(file, "    \"unidentified\": %d\n  }\n}\n", protocol->matched);
+
+    error = ( fflush(file) != 0 || ferror(file) );
+    if (file != stdout && fclose(file) != 0)
+        error = 1;
+
+    if (error)
+    {
+        logErrorErrno("error writing stats file \"%s\"", filename);
+        return (-3);
+    }
+    return (0);
+}
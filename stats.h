@@ -0,0 +1,33 @@
+/*
+    @file stats.h
+
+    Timings and counts for each phase of a run, written out as JSON at the
+    end (--stats), so throughput can be tracked from one release to the next.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+typedef enum {
+    kImportPhase,
+    kAnalysisPhase,     /* identifying the protocols - adjustment is timed separately */
+    kAdjustmentPhase,
+    kExportPhase,
+    kPhaseCount
+} tPhase;
+
+/* nothing is timed or counted until this is called */
+void enableStats(void);
+int statsEnabled(void);
+
+void startPhase(tPhase phase);
+void endPhase(tPhase phase);
+
+/* adjustment happens in the middle of analysis, on each analysis thread */
+unsigned long long statsClock(void);    /* microseconds */
+void countAdjustment(unsigned long long totalMicros, unsigned long long longestMicros);
+
+void countBytesRead(unsigned long long bytes);
+void countBytesWritten(unsigned long long bytes);
+void countCodeSet(tIRCodeSet *codeSet);
+
+int writeStats(const char *filename, int threadCount);
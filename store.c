@@ -0,0 +1,158 @@
+/*
+    @file store.c
+
+    The in-memory database. Code sets and codes are kept in arrays that
+    grow by doubling, and refer to each other by index - so the arrays can
+    move while the database is being built, and a finished one can be
+    walked from one end to the other.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include "analyse-ir-codes.h"
+#include "store.h"
+
+#define MIN_CODE_SETS   64
+#define MIN_CODES       1024
+
+static void reserveCodeSets(tCodeStore *store, size_t count)
+{
+    tIRCodeSet  *codeSets;
+    size_t      size;
+
+    if (count <= store->codeSetSize)
+        return;
+
+    for (size = (store->codeSetSize > 0) ? store->codeSetSize : MIN_CODE_SETS; size < count; size *= 2)
+        { }
+
+    codeSets = realloc( store->codeSets, size * sizeof(tIRCodeSet) );
+    if (codeSets == NULL)
+        fatalExit(-4, "unable to allocate %lu code sets", (unsigned long)size);
+
+    store->codeSets    = codeSets;
+    store->codeSetSize = size;
+}
+
+static void reserveCodes(tCodeStore *store, size_t count)
+{
+    tIRCode         *codes;
+    tIRCodeLabel    *labels;
+    size_t          size;
+
+    if (count <= store->codeSize)
+        return;
+
+    for (size = (store->codeSize > 0) ? store->codeSize : MIN_CODES; size < count; size *= 2)
+        { }
+
+    codes  = realloc( store->codes,  size * sizeof(tIRCode) );
+    if (codes != NULL)
+        store->codes = codes;
+    labels = realloc( store->labels, size * sizeof(tIRCodeLabel) );
+    if (labels != NULL)
+        store->labels = labels;
+    if (codes == NULL || labels == NULL)
+        fatalExit(-4, "unable to allocate %lu codes", (unsigned long)size);
+
+    store->codeSize = size;
+}
+
+tIRCodeSet *addCodeSet(tCodeStore *store)
+{
+    tIRCodeSet  *codeSet;
+
+    reserveCodeSets(store, store->codeSetCount + 1);
+
+    codeSet = &store->codeSets[store->codeSetCount++];
+    memset(codeSet, 0, sizeof(tIRCodeSet));
+    codeSet->firstCode = store->codeCount;
+
+    return codeSet;
+}
+
+tIRCode *addCode(tCodeStore *store)
+{
+    tIRCode     *code;
+
+    reserveCodes(store, store->codeCount + 1);
+
+    code = &store->codes[store->codeCount];
+    memset(code, 0, sizeof(tIRCode));
+    memset(&store->labels[store->codeCount], 0, sizeof(tIRCodeLabel));
+    ++store->codeCount;
+
+    code->codeSet = store->codeSetCount - 1;
+    ++store->codeSets[code->codeSet].codeCount;
+
+    return code;
+}
+
+void appendCodeStore(tCodeStore *dest, tCodeStore *src)
+{
+    size_t      i, merged, setOffset, codeOffset;
+    tIRCodeSet  *codeSet;
+
+    /* e.g. a chunk that was all comments - there's nothing to move, but it still owns its arrays */
+    if (src->codeCount == 0)
+    {
+        releaseCodeStore(src);
+        return;
+    }
+
+    if (dest->codeCount == 0)
+    {
+        /* nothing to append to - just take src's arrays */
+        releaseCodeStore(dest);
+        *dest = *src;
+        memset(src, 0, sizeof(tCodeStore));
+        return;
+    }
+
+    merged = (src->codeSets[0].id == dest->codeSets[dest->codeSetCount - 1].id);
+    if (merged)
+        dest->codeSets[dest->codeSetCount - 1].codeCount += src->codeSets[0].codeCount;
+
+    setOffset  = dest->codeSetCount - merged;
+    codeOffset = dest->codeCount;
+
+    reserveCodeSets(dest, setOffset + src->codeSetCount);
+    for (i = merged; i < src->codeSetCount; ++i)
+    {
+        codeSet = &dest->codeSets[setOffset + i];
+        *codeSet = src->codeSets[i];
+        codeSet->firstCode += codeOffset;
+    }
+    dest->codeSetCount = setOffset + src->codeSetCount;
+
+    reserveCodes(dest, codeOffset + src->codeCount);
+    memcpy( &dest->codes[codeOffset],  src->codes,  src->codeCount * sizeof(tIRCode) );
+    memcpy( &dest->labels[codeOffset], src->labels, src->codeCount * sizeof(tIRCodeLabel) );
+    for (i = 0; i < src->codeCount; ++i)
+        dest->codes[codeOffset + i].codeSet += setOffset;
+    dest->codeCount = codeOffset + src->codeCount;
+
+    arenaAdopt( &dest->labelText, &src->labelText );
+    free( src->codeSets );
+    free( src->codes );
+    free( src->labels );
+    memset(src, 0, sizeof(tCodeStore));
+}
+
+void resetCodeStore(tCodeStore *store)
+{
+    store->codeSetCount = 0;
+    store->codeCount    = 0;
+    arenaReset( &store->labelText );
+}
+
+void releaseCodeStore(tCodeStore *store)
+{
+    free( store->codeSets );
+    free( store->codes );
+    free( store->labels );
+    arenaRelease( &store->labelText );
+    memset(store, 0, sizeof(tCodeStore));
+}
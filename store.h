@@ -0,0 +1,23 @@
+/*
+    @file store.h
+
+    Building and tearing down a tCodeStore. Both add functions may move
+    the arrays, so pointers into them don't survive adding more.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+/* returns a zeroed code set at the end of the store */
+tIRCodeSet *addCodeSet(tCodeStore *store);
+
+/* returns a zeroed code (and label) at the end of the store, in its last code set */
+tIRCode *addCode(tCodeStore *store);
+
+/* moves src's code sets and codes onto the end of dest's, leaving src empty.
+   If src starts with the code set dest ends with, the two are merged */
+void appendCodeStore(tCodeStore *dest, tCodeStore *src);
+
+/* empty the store, keeping the arrays for re-use */
+void resetCodeStore(tCodeStore *store);
+
+void releaseCodeStore(tCodeStore *store);
@@ -1,5 +1,8 @@
 /* automatically generated by generateHashes - DO NOT EDIT! */
-#define qHashFullRepeat                       (0x0814c8db)
-#define qHashPartialRepeat                    (0xa6d1a33b)
+#define qHashFullRepeat                       (0x18ec6000814c8db)
+#define qHashPartialRepeat                    (0xc7b4ab20a6d1a33b)
 #define qHashRepeat                           (0xc651e3d7)
 #define qHashToggle                           (0xc2607712)
+#define qHashtext                             (0x003df99d)
+#define qHashbinary                           (0xe78c2e4f)
+#define qHashfirmware                         (0x400da1688f1)
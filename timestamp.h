@@ -1,4 +1,4 @@
 /* generated by build - do not edit */
-#define BUILD_DATE       "Wednesday, May 28"
-#define EXPIRY_DATE      "Wednesday, June 11"
-#define EXPIRY_TIMESTAMP 1402556400UL
+#define BUILD_DATE       "Saturday, October 17"
+#define EXPIRY_DATE      "Saturday, October 31"
+#define EXPIRY_TIMESTAMP 1793491200UL
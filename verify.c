@@ -0,0 +1,653 @@
+/*
+    @file verify.c
+
+    The analysis as it was first written - an insertion sort into the
+    histograms, a division in every fuzzy match, a scan of the whole
+    protocol table and an adjustment a period at a time. None of it is
+    meant to be fast. It's kept so that the optimized kernels in analyse.c
+    and match.c can be checked against it, a whole database at a time.
+
+    The real analysis adjusts the streams in place, so the reference pass
+    runs first. It keeps each code's fingerprint, and a hash of each of its
+    streams as adjusted, to compare with once the real analysis is done.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+#include "common.h"
+
+#include <pthread.h>
+
+#include "analyse-ir-codes.h"
+#include "analyse.h"
+#include "verify.h"
+
+typedef struct {
+    tFingerprint        fingerprint;    /* the histograms are in a worker's arena */
+    unsigned long long  stream[4];      /* hashes of first.a, first.b, repeat.a and repeat.b */
+    int                 fixedRepeat;    /* the repeat streams are replaced with the protocol's own */
+} tReferenceResult;
+
+static const char *gStreamName[4] = { "first/a", "first/b", "repeat/a", "repeat/b" };
+
+/* the codes are split evenly - there's no stealing, as the reference pass is slow everywhere */
+typedef struct {
+    pthread_t       thread;
+    size_t          first, end;     /* this worker's part of gStore.codes */
+    tArena          arena;          /* the reference histograms */
+    tIRStream       *scratch;       /* a copy of the stream being adjusted */
+    tCount          scratchSize;    /* in periods */
+    unsigned long   differences;
+} tVerifyWorker;
+
+static struct {
+    tReferenceResult *result;       /* parallel to gStore.codes */
+    tVerifyWorker   *workers;
+    int             workerCount;
+} gVerify;
+
+/* as fuzzyMatch() was, before the division was taken out */
+static int referenceFuzzyMatch(unsigned long reference, unsigned long value, unsigned int threshold)
+{
+    unsigned long difference;
+
+    difference = (reference > value) ? (reference - value) : (value - reference);
+    return ( ((difference * 1000 * 2) / (reference + value)) < threshold );
+}
+
+static int referenceDurationsMatch(int durationA, int durationB)
+{
+    if (durationA == 0 || durationB == 0)
+        return (durationA == durationB);
+
+    return referenceFuzzyMatch( durationA, durationB, MATCH_TOLERANCE );
+}
+
+/* the first entry of the table that matches, rather than a lookup in the protocol index */
+static tReferenceFingerprint *referenceIdentifyProtocol(tFingerprint *fingerprint)
+{
+    tReferenceFingerprint   *protocol;
+    int refCarrier;
+    int fpCarrier, fpLeadMark, fpLeadSpace, fpDuration;
+    int i, symbolsMatch;
+
+    /* scale appropriately, to avoid both overflow and loss-of-precision */
+    fpCarrier = fingerprint->carrierFreq/100;
+    fpLeadMark  = (fingerprint->leading.mark * 1000) / fpCarrier;
+    fpLeadSpace = (fingerprint->leading.space * 1000) / fpCarrier;
+    fpDuration  = (fingerprint->duration * 1000) / fpCarrier;
+
+    for (protocol = &gProtocol[0]; protocol->confidence != kListEnd; ++protocol)
+    {
+        if ( fingerprint->encoding != protocol->encoding
+          && !(fingerprint->encoding == kAmbiguous && protocol->encoding < kAmbiguous) )
+            continue;
+
+        symbolsMatch = 0;
+        for (i = 0; i < SYMBOL_ARRAY_SIZE && protocol->symbolCounts[i] != 0; ++i)
+        {
+            if (protocol->symbolCounts[i] == (int)fingerprint->symbolCount)
+                symbolsMatch = 1;
+        }
+        if (!symbolsMatch)
+            continue;
+
+        refCarrier = protocol->carrierFreq/100;
+        if ( referenceDurationsMatch((protocol->leading.mark*1000)/refCarrier,  fpLeadMark )
+          && referenceDurationsMatch((protocol->leading.space*1000)/refCarrier, fpLeadSpace )
+          && referenceDurationsMatch((protocol->duration*1000)/refCarrier, fpDuration) )
+            return protocol;
+    }
+    return NULL;
+}
+
+/* keeps the histogram sorted as each period is added, rather than sorting once at the end */
+static void referenceInsertIntoHistogram( tRawHistogram *hist, tPeriod period )
+{
+    unsigned int insert,insertAt;
+    tCount j;
+
+    /* default is to append, if the loop completes (i.e. period is the largest seen so far) */
+    insert = 1;
+    insertAt = hist->count;
+    for (j = 0; j < hist->count; j++)
+    {
+        if (period == hist->d[j].period)
+        {
+            ++hist->d[j].count;
+            insert = 0;     /* don't insert, we found an existing entry */
+            break;
+        }
+        else if (period < hist->d[j].period)
+        {
+            insertAt = j;
+            /* move the latter half of the array up by one, to make a hole */
+            for (j = hist->count; j > insertAt; --j)
+            {
+                hist->d[j].period = hist->d[j-1].period;
+                hist->d[j].count  = hist->d[j-1].count;
+            }
+            break;
+        }
+    }
+    if (insert) /* or append */
+    {
+        hist->d[insertAt].period = period;
+        hist->d[insertAt].count = 1;
+        if (hist->count < MAX_HIST_SIZE - 1)
+            ++hist->count;
+    }
+}
+
+static tHistogram *referenceDupHistogram(tArena *arena, tRawHistogram *raw)
+{
+    tHistogram *result;
+    tCount i;
+
+    if (raw->count == 0)
+        return NULL;
+
+    result = arenaAlloc( arena, sizeof(tHistogram) + (raw->count * sizeof(tHistEntry)) );
+    if (result == NULL)
+        fatalExit(-4, "unable to allocate a reference histogram");
+
+    result->count = raw->count;
+    for (i = 0; i < raw->count; ++i)
+        result->d[i] = raw->d[i];
+
+    return result;
+}
+
+static tHistogram *referenceNormalizeHistogram(tArena *arena, tRawHistogram *hist)
+{
+    tCount i;
+    int refPeriod;
+    unsigned long   periodSum;
+    tCount          periodCount;
+    tRawHistogram   symbols;
+
+    symbols.count = 0;
+    i = 0;
+    while (i < hist->count)
+    {
+        /* collapse runs of periods that differ by under 10% */
+        refPeriod = hist->d[i].period;
+        periodSum = 0;
+        periodCount = 0;
+        while ( (i < hist->count) && referenceFuzzyMatch( refPeriod + 7, hist->d[i].period, MATCH_TOLERANCE) )
+        {
+            periodSum   += (hist->d[i].period * hist->d[i].count);
+            periodCount += hist->d[i].count;
+
+            refPeriod   = hist->d[i].period;
+            ++i;
+        }
+        if (periodCount > 0)
+        {
+            symbols.d[symbols.count].period = periodSum / periodCount;
+            symbols.d[symbols.count].count  = periodCount;
+
+            if (symbols.count < MAX_HIST_SIZE)
+            ++symbols.count;
+        }
+    }
+    return referenceDupHistogram(arena, &symbols);
+}
+
+/* if the period is one of the histogram's symbols, count it as one. Returns zero if not */
+static int referenceCountSymbol(tHistogram *hist, unsigned long period)
+{
+    tCount j;
+
+    for (j = 0; hist != NULL && j < hist->count; j++)
+    {
+        if ( referenceFuzzyMatch(hist->d[j].period, toPeriod(period), MATCH_TOLERANCE) )
+        {
+            ++hist->d[j].count;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static tCount histogramCount(tHistogram *hist)
+{
+    return (hist != NULL) ? hist->count : 0;
+}
+
+static void referenceAnalyzeIRStream(tArena *arena, tIRStream *stream, tFingerprint *fingerprint)
+{
+    tRawHistogram   mark, space, *rhist;
+    tHistogram      *hist;
+    tCount  i, last;
+
+    mark.count = 0;
+    space.count = 0;
+    rhist = &mark;
+    last = (stream->count - 2);
+
+    fingerprint->duration = stream->period[0];
+    fingerprint->duration += stream->period[1];
+    for (i = 2; i < last; ++i)
+    {
+        fingerprint->duration += stream->period[i];
+
+        referenceInsertIntoHistogram(rhist, toPeriod(stream->period[i]));
+        rhist = (rhist != &mark)? &mark : &space;
+    }
+    fingerprint->duration += stream->period[i++]; /* last mark */
+    fingerprint->duration += stream->period[i];   /* add in the inter-code gap */
+
+    fingerprint->mark  = referenceNormalizeHistogram(arena, &mark);
+    fingerprint->space = referenceNormalizeHistogram(arena, &space);
+
+    /* are the leading pair and the trailing mark also valid symbols? */
+    fingerprint->leading.mark   = stream->period[0];
+    if ( referenceCountSymbol( fingerprint->mark, fingerprint->leading.mark ) )
+        fingerprint->leading.mark = 0;
+
+    fingerprint->leading.space  = stream->period[1];
+    if ( referenceCountSymbol( fingerprint->space, fingerprint->leading.space ) )
+        fingerprint->leading.space = 0;
+
+    fingerprint->trailing.mark  = stream->period[stream->count - 2];
+    if ( referenceCountSymbol( fingerprint->mark, fingerprint->trailing.mark ) )
+        fingerprint->trailing.mark = 0;
+
+    fingerprint->trailing.space = stream->period[stream->count - 1];
+
+    /* the same decisions as analyzeIRStream() - see there for the reasoning */
+    switch (histogramCount(fingerprint->mark))
+    {
+    case 1:
+        switch (histogramCount(fingerprint->space))
+        {
+        case 0:  fingerprint->encoding = kUnknown; break;
+        case 1:  fingerprint->encoding = kAmbiguous; break;
+        case 2:  fingerprint->encoding = kSpaceVaries; break;
+        case 3:
+            if (fingerprint->space->d[2].count == 1)
+                fingerprint->encoding = kSpaceVariesExtended;
+            else
+                fingerprint->encoding = kPPM;
+            break;
+        default: fingerprint->encoding = kPPM; break;
+        }
+        break;
+
+    case 2:
+        switch (histogramCount(fingerprint->space))
+        {
+        case 1:
+            if (fingerprint->mark->d[1].count == 1)
+                fingerprint->encoding = kAmbiguous;
+            else
+                fingerprint->encoding = kMarkVaries;
+            break;
+        case 2:  fingerprint->encoding = kBiphase; break;
+        case 3:
+            if (fingerprint->space->d[2].count == 1)
+                fingerprint->encoding = kBiphaseExtended;
+            else
+                fingerprint->encoding = kUnknown;
+            break;
+        default: fingerprint->encoding = kUnknown; break;
+        }
+        break;
+
+    case 3:
+        if (fingerprint->mark->d[2].count == 1)
+            fingerprint->encoding = kBiphaseExtended;
+        else
+            fingerprint->encoding = kUnknown;
+        break;
+
+    default:
+        fingerprint->encoding = kUnknown;
+        break;
+    }
+
+    fingerprint->symbolCount = 0;
+    hist = NULL;
+    switch (fingerprint->encoding)
+    {
+    case kMarkVaries:
+    case kMarkVariesExtended:
+        hist = fingerprint->mark;
+        break;
+
+    case kAmbiguous:
+    case kSpaceVaries:
+    case kSpaceVariesExtended:
+    case kPPM:
+        hist = fingerprint->space;
+        break;
+
+    case kBiphase:
+    case kBiphaseExtended:
+        fingerprint->symbolCount =  fingerprint->mark->d[0].count;
+        fingerprint->symbolCount += fingerprint->mark->d[1].count * 2;
+        fingerprint->symbolCount += fingerprint->space->d[0].count;
+        fingerprint->symbolCount += fingerprint->space->d[1].count * 2;
+        fingerprint->symbolCount /= 2;
+        break;
+
+    default:
+        break;
+    }
+
+    for (i = 0; i < histogramCount(hist); ++i)
+        fingerprint->symbolCount += hist->d[i].count;
+}
+
+static int referenceSnapPeriod( unsigned long *period, const unsigned int *refhist )
+{
+    int i;
+
+    for (i = 0; i < 4 && refhist[i] != 0; ++i)
+    {
+        if ( referenceFuzzyMatch(refhist[i], *period, ADJUST_TOLERANCE) )
+        {
+            *period = refhist[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* a period at a time, keeping track of what's left of the duration for the last space */
+static void referenceAdjustIRStream(tIRStream *stream, tReferenceFingerprint *refprint)
+{
+    unsigned long intracodeGap;
+    unsigned long *period;
+    tCount  count;
+
+    count = stream->count & ~1UL;
+    period = &stream->period[0];
+    intracodeGap = refprint->duration;
+
+    if (count >= 2)
+    {
+        if (refprint->leading.mark != 0)
+            *period = refprint->leading.mark;
+        else
+            referenceSnapPeriod( period, refprint->mark );
+        intracodeGap -= *period++;
+
+        if (refprint->leading.space != 0)
+            *period = refprint->leading.space;
+        else
+            referenceSnapPeriod( period, refprint->space );
+        intracodeGap -= *period++;
+
+        count -= 2;
+    }
+
+    while (count > 0)
+    {
+        referenceSnapPeriod( period, refprint->mark );
+        intracodeGap -= *period++;
+        --count;
+
+        if (count == 1)
+            *period++ = intracodeGap;
+        else
+        {
+            referenceSnapPeriod( period, refprint->space );
+            intracodeGap -= *period++;
+        }
+        --count;
+    }
+}
+
+static unsigned long long hashStream(const tIRStream *stream)
+{
+    unsigned long long hash = WORD_HASH_SEED;
+    tCount i;
+
+    if (stream == NULL)
+        return 0;
+
+    hash = WORD_HASH_STEP( hash, stream->count );
+    for (i = 0; i < stream->count; ++i)
+        hash = WORD_HASH_STEP( hash, stream->period[i] );
+
+    return hash;
+}
+
+/* the hash of the stream once adjusted for refprint - which may be NULL, to leave it as it is */
+static unsigned long long referenceAdjustedHash(tVerifyWorker *worker, tIRStream *stream, tReferenceFingerprint *refprint)
+{
+    size_t size;
+
+    if (stream == NULL || refprint == NULL)
+        return hashStream(stream);
+
+    size = sizeof(tIRStream) + stream->count * sizeof(unsigned long);
+    if (stream->count > worker->scratchSize)
+    {
+        free(worker->scratch);
+        worker->scratch = malloc(size);
+        if (worker->scratch == NULL)
+            fatalExit(-4, "unable to allocate memory to verify a stream");
+        worker->scratchSize = stream->count;
+    }
+    memcpy( worker->scratch, stream, size );
+
+    referenceAdjustIRStream( worker->scratch, refprint );
+    return hashStream( worker->scratch );
+}
+
+/* what analyzeIRCode() and adjustIRCode() should make of the code */
+static void referenceAnalyzeIRCode(tVerifyWorker *worker, tIRCode *code, tReferenceResult *result)
+{
+    tFingerprint            *fingerprint = &result->fingerprint;
+    tReferenceFingerprint   *adjustFor = NULL;
+
+    *fingerprint = code->fingerprint;
+    if (code->first.a != NULL)
+        referenceAnalyzeIRStream( &worker->arena, code->first.a, fingerprint );
+
+    fingerprint->protocol = referenceIdentifyProtocol( fingerprint );
+
+    if (fingerprint->protocol != NULL
+      && (fingerprint->protocol->confidence == kFromSpec || fingerprint->protocol->confidence == kMeasured))
+    {
+        adjustFor = fingerprint->protocol;
+        fingerprint->carrierFreq = adjustFor->carrierFreq;
+        result->fixedRepeat = (adjustFor->repeatStream != kUnknownRepeatStream);
+    }
+
+    result->stream[0] = referenceAdjustedHash( worker, code->first.a, adjustFor );
+    result->stream[1] = referenceAdjustedHash( worker, code->first.b, adjustFor );
+    if (!result->fixedRepeat)
+    {
+        result->stream[2] = referenceAdjustedHash( worker, code->repeat.a, adjustFor );
+        result->stream[3] = referenceAdjustedHash( worker, code->repeat.b, adjustFor );
+    }
+}
+
+static int compareValue(tIRCode *code, const char *what, unsigned long value, unsigned long reference)
+{
+    if (value == reference)
+        return 0;
+
+    logError("verify: line %u - %s is %lu, the reference has %lu",
+                labelOf(code)->lineNumber, what, value, reference);
+    return 1;
+}
+
+static int compareHistogram(tIRCode *code, const char *what, tHistogram *hist, tHistogram *reference)
+{
+    tCount i;
+
+    if (histogramCount(hist) != histogramCount(reference))
+    {
+        logError("verify: line %u - the %s histogram has %lu entries, the reference has %lu",
+                    labelOf(code)->lineNumber, what, histogramCount(hist), histogramCount(reference));
+        return 1;
+    }
+
+    for (i = 0; i < histogramCount(hist); ++i)
+    {
+        if (hist->d[i].period != reference->d[i].period || hist->d[i].count != reference->d[i].count)
+        {
+            logError("verify: line %u - %s histogram entry %lu is %lu:%lu, the reference has %lu:%lu",
+                        labelOf(code)->lineNumber, what, i,
+                        hist->d[i].period, hist->d[i].count,
+                        reference->d[i].period, reference->d[i].count);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* returns non-zero if the code differs from the reference. Each difference is logged */
+static int compareIRCode(tIRCode *code, tReferenceResult *result)
+{
+    tFingerprint    *fingerprint = &code->fingerprint;
+    tFingerprint    *reference   = &result->fingerprint;
+    tIRStream       *stream[4];
+    int             differs, i;
+
+    differs  = compareValue( code, "the encoding",       fingerprint->encoding,       reference->encoding );
+    differs |= compareValue( code, "the symbol count",   fingerprint->symbolCount,    reference->symbolCount );
+    differs |= compareValue( code, "the leading mark",   fingerprint->leading.mark,   reference->leading.mark );
+    differs |= compareValue( code, "the leading space",  fingerprint->leading.space,  reference->leading.space );
+    differs |= compareValue( code, "the trailing mark",  fingerprint->trailing.mark,  reference->trailing.mark );
+    differs |= compareValue( code, "the trailing space", fingerprint->trailing.space, reference->trailing.space );
+    differs |= compareValue( code, "the duration",       fingerprint->duration,       reference->duration );
+    differs |= compareHistogram( code, "mark",  fingerprint->mark,  reference->mark );
+    differs |= compareHistogram( code, "space", fingerprint->space, reference->space );
+
+    /* the streams were adjusted for different protocols, so can't be compared */
+    if (fingerprint->protocol != reference->protocol)
+    {
+        logError("verify: line %u - identified as %s, the reference as %s",
+                    labelOf(code)->lineNumber,
+                    (fingerprint->protocol != NULL) ? fingerprint->protocol->name : "nothing",
+                    (reference->protocol   != NULL) ? reference->protocol->name   : "nothing" );
+        return 1;
+    }
+    differs |= compareValue( code, "the carrier", fingerprint->carrierFreq, reference->carrierFreq );
+
+    stream[0] = code->first.a;
+    stream[1] = code->first.b;
+    stream[2] = code->repeat.a;
+    stream[3] = code->repeat.b;
+
+    /* a fixed repeat stream comes straight from a table, there's nothing to check */
+    for (i = 0; i < (result->fixedRepeat ? 2 : 4); ++i)
+    {
+        if (hashStream(stream[i]) != result->stream[i])
+        {
+            logError("verify: line %u - the adjusted %s stream differs from the reference",
+                        labelOf(code)->lineNumber, gStreamName[i]);
+            differs = 1;
+        }
+    }
+    return differs;
+}
+
+static void *referenceWorker(void *arg)
+{
+    tVerifyWorker   *worker = arg;
+    size_t          i;
+
+    for (i = worker->first; i < worker->end; ++i)
+        referenceAnalyzeIRCode( worker, &gStore.codes[i], &gVerify.result[i] );
+
+    return NULL;
+}
+
+static void *compareWorker(void *arg)
+{
+    tVerifyWorker   *worker = arg;
+    size_t          i;
+
+    for (i = worker->first; i < worker->end; ++i)
+        worker->differences += compareIRCode( &gStore.codes[i], &gVerify.result[i] );
+
+    return NULL;
+}
+
+static void runVerifyWorkers(void *(*work)(void *))
+{
+    tVerifyWorker   *worker;
+    int             w;
+
+    /* the last worker runs on this thread */
+    for (w = 0; w < gVerify.workerCount; ++w)
+    {
+        worker = &gVerify.workers[w];
+        if (w == gVerify.workerCount - 1 || pthread_create( &worker->thread, NULL, work, worker ) != 0)
+        {
+            worker->thread = pthread_self();
+            work( worker );
+        }
+    }
+
+    for (w = 0; w < gVerify.workerCount; ++w)
+    {
+        worker = &gVerify.workers[w];
+        if ( !pthread_equal( worker->thread, pthread_self() ) )
+            pthread_join( worker->thread, NULL );
+    }
+}
+
+void startVerify(int threadCount)
+{
+    size_t  total = gStore.codeCount;
+    int     w;
+
+    if (threadCount < 1)
+        threadCount = 1;
+    if ((size_t)threadCount > total)
+        threadCount = (total > 0) ? total : 1;
+
+    gVerify.result  = calloc( total + 1, sizeof(tReferenceResult) );
+    gVerify.workers = calloc( threadCount, sizeof(tVerifyWorker) );
+    if (gVerify.result == NULL || gVerify.workers == NULL)
+        fatalExit(-4, "unable to allocate memory to verify the analysis");
+
+    gVerify.workerCount = threadCount;
+    for (w = 0; w < threadCount; ++w)
+    {
+        gVerify.workers[w].first = (total * w) / threadCount;
+        gVerify.workers[w].end   = (total * (w + 1)) / threadCount;
+    }
+
+    runVerifyWorkers( referenceWorker );
+}
+
+unsigned long finishVerify(void)
+{
+    tVerifyWorker   *worker;
+    unsigned long   differences = 0;
+    int             w;
+
+    runVerifyWorkers( compareWorker );
+
+    for (w = 0; w < gVerify.workerCount; ++w)
+    {
+        worker = &gVerify.workers[w];
+        differences += worker->differences;
+
+        arenaRelease( &worker->arena );
+        free( worker->scratch );
+    }
+
+    if (differences != 0)
+    {
+        logError("verify: %lu of %lu codes differ from the reference analysis", differences, (unsigned long)gStore.codeCount);
+    }
+    else logInfo("verify: all %lu codes match the reference analysis", (unsigned long)gStore.codeCount);
+
+    free( gVerify.workers );
+    free( gVerify.result );
+    gVerify.workers = NULL;
+    gVerify.result  = NULL;
+    gVerify.workerCount = 0;
+
+    return differences;
+}
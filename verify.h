@@ -0,0 +1,14 @@
+/*
+    @file verify.h
+
+    --verify: every code is also analysed by the original, unoptimized
+    implementations, and anything the two disagree on is reported.
+
+    Copyright 2011, Paul Chambers. All Rights Reserved.
+*/
+
+/* runs the reference analysis - call after importing, before analyzeIRCodeSets() */
+void startVerify(int threadCount);
+
+/* compares with the analysis since startVerify(). Returns the number of codes that differ */
+unsigned long finishVerify(void);